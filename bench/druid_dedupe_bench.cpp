@@ -0,0 +1,230 @@
+/**
+ * compares the actor dedupe of druid::Resource and druid::Active with the vector and
+ * string based version they replaced.
+ *
+ * transactions are either synthetic, with a given number of actions over a given number of
+ * distinct accounts, or recorded : FileProducer lines of a struct holding whole traces,
+ * like hbase.transactiontrace ({"json": "<trace>"}) or any record with action_traces.
+ * both versions must produce the same keys, the run fails otherwise.
+ */
+#include <chrono>
+#include <random>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/data_plugin/types.hpp>
+
+using namespace eosio::chain;
+using namespace eosio::data;
+using std::vector;
+namespace bpo = boost::program_options;
+
+//the builders before the rework, only the keys matter here
+static vector<string> legacy_resource(const transaction_trace_ptr& ttp) {
+    vector<string> keys;
+    std::vector<string> actors;
+    string receiver = "";
+    if (ttp->receipt) {
+        auto receipt_header = *(ttp->receipt);
+        for (auto trace : ttp->action_traces) {
+            for (auto auth : trace.act.authorization) {
+                auto actor = auth.actor;
+                if (std::find(actors.begin(), actors.end(), string(actor)) == actors.end()) {
+                    actors.push_back(string(actor));
+                }
+            }
+            if (receiver == "") {
+                receiver = string(trace.receipt.receiver);
+            }
+        }
+        for (auto actor : actors) {
+            auto resobj = fc::mutable_variant_object
+                ("block_time", ttp->block_time)
+                ("trx", ttp->id)
+                ("cpu_usage_us", static_cast<uint32_t>(receipt_header.cpu_usage_us))
+                ("net_usage_words", static_cast<uint32_t>(receipt_header.net_usage_words))
+                ("actor", actor)
+                ("receiver",receiver)
+            ;
+            keys.push_back(string(ttp->id) + "|" + string(actor));
+        }
+    }
+    return keys;
+}
+
+static vector<string> legacy_active(const transaction_trace_ptr& ttp) {
+    vector<string> keys;
+    std::vector<string> actor_receivers;
+    if (ttp->receipt) {
+        for (auto trace : ttp->action_traces) {
+            auto receiver = trace.receipt.receiver;
+            auto action = trace.act.account;
+            auto name = trace.act.name;
+            for (auto auth : trace.act.authorization) {
+                auto actor = auth.actor;
+                string actor_receiver = string(actor) + ":" + string(receiver) + ":" + string(action) + "_" + string(name);
+                if (std::find(actor_receivers.begin(), actor_receivers.end(), actor_receiver) == actor_receivers.end()) {
+                    actor_receivers.push_back(actor_receiver);
+                }
+            }
+        }
+        for (auto actor_receiver : actor_receivers) {
+            size_t first_pos = actor_receiver.find(":");
+            string actor = actor_receiver.substr(0, first_pos);
+            size_t secon_pos = actor_receiver.find(":", first_pos+1);
+            string receiver = actor_receiver.substr(first_pos+1, secon_pos-first_pos-1);
+            string action_name = actor_receiver.substr(secon_pos+1);
+            auto resobj = fc::mutable_variant_object
+                ("block_time", ttp->block_time)
+                ("trx", ttp->id)
+                ("actor", actor)
+                ("receiver",receiver)
+                ("method", action_name)
+            ;
+            keys.push_back(string(ttp->id) + "|" + string(actor_receiver));
+        }
+    }
+    return keys;
+}
+
+static name random_name(std::mt19937_64& rng, uint32_t distinct) {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz12345";
+    auto n = rng() % distinct;
+    string s = "acc";
+    for (int i = 0; i < 9; i ++, n /= 31)
+        s += chars[n % 31];
+    return name(s);
+}
+
+static vector<transaction_trace_ptr> synthetic_traces(uint32_t trx_num, uint32_t actions, uint32_t distinct) {
+    std::mt19937_64 rng(42);
+    vector<transaction_trace_ptr> traces;
+    for (uint32_t i = 0; i < trx_num; i ++) {
+        auto ttp = std::make_shared<transaction_trace>();
+        ttp->id = fc::sha256::hash(std::to_string(i));
+        ttp->receipt = transaction_receipt_header();
+        for (uint32_t a = 0; a < actions; a ++) {
+            action_trace trace;
+            trace.receipt.receiver = random_name(rng, distinct);
+            trace.act.account = random_name(rng, distinct);
+            trace.act.name = N(transfer);
+            trace.act.authorization.push_back({random_name(rng, distinct), N(active)});
+            ttp->action_traces.push_back(trace);
+        }
+        traces.push_back(ttp);
+    }
+    return traces;
+}
+
+static action_trace load_action(const fc::variant_object& obj) {
+    action_trace trace;
+    auto& receipt = obj["receipt"].get_object();
+    trace.receipt.receiver = receipt["receiver"].as<name>();
+    auto& act = obj["act"].get_object();
+    trace.act.account = act["account"].as<name>();
+    trace.act.name = act["name"].as<name>();
+    for (auto& auth : act["authorization"].get_array())
+        trace.act.authorization.push_back({auth["actor"].as<name>(), auth["permission"].as<name>()});
+    if (obj.contains("inline_traces"))
+        for (auto& inline_trace : obj["inline_traces"].get_array())
+            trace.inline_traces.push_back(load_action(inline_trace.get_object()));
+    return trace;
+}
+
+static vector<transaction_trace_ptr> recorded_traces(const string& file_name) {
+    vector<transaction_trace_ptr> traces;
+    std::ifstream file(file_name);
+    string line;
+    while (std::getline(file, line)) {
+        auto second = line.find('\t', line.find('\t') + 1);
+        if (second == string::npos) continue;
+        try {
+            auto value = fc::json::from_string(line.substr(second + 1));
+            if (value.get_object().contains("json"))
+                value = fc::json::from_string(value["json"].as_string());
+            auto& obj = value.get_object();
+            if (!obj.contains("action_traces")) continue;
+            auto ttp = std::make_shared<transaction_trace>();
+            ttp->id = obj["id"].as<transaction_id_type>();
+            ttp->receipt = transaction_receipt_header();
+            for (auto& trace : obj["action_traces"].get_array())
+                ttp->action_traces.push_back(load_action(trace.get_object()));
+            traces.push_back(ttp);
+        } catch (const fc::exception& ex) {
+            continue;
+        }
+    }
+    return traces;
+}
+
+template <typename F>
+static double ns_per_trx(const vector<transaction_trace_ptr>& traces, uint32_t rounds, F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    for (uint32_t r = 0; r < rounds; r ++)
+        for (auto& ttp : traces)
+            sink += f(ttp);
+    auto end = std::chrono::steady_clock::now();
+    if (sink == size_t(-1)) std::cout << sink;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / double(rounds * traces.size());
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description options_desc("druid dedupe benchmark options");
+    options_desc.add_options()
+        ("help,h", "print this help message and exit")
+        ("trace-file", bpo::value<string>(), "FileProducer output with whole transaction traces, synthetic traces if not set")
+        ("trx-num", bpo::value<uint32_t>()->default_value(1000), "synthetic : the number of transactions")
+        ("actions", bpo::value<uint32_t>()->default_value(300), "synthetic : the actions of a transaction")
+        ("distinct", bpo::value<uint32_t>()->default_value(100), "synthetic : the distinct accounts the actions are drawn from")
+        ("rounds", bpo::value<uint32_t>()->default_value(5), "the passes over all transactions")
+    ;
+    bpo::variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, options_desc), options);
+    bpo::notify(options);
+    if (options.count("help")) {
+        std::cout << options_desc << std::endl;
+        return 0;
+    }
+    fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+    auto traces = options.count("trace-file")
+        ? recorded_traces(options["trace-file"].as<string>())
+        : synthetic_traces(options["trx-num"].as<uint32_t>(), options["actions"].as<uint32_t>(), options["distinct"].as<uint32_t>());
+    if (traces.empty()) {
+        std::cerr << "no transaction trace to run" << std::endl;
+        return 1;
+    }
+    auto rounds = std::max<uint32_t>(1, options["rounds"].as<uint32_t>());
+    fc::mutable_variant_object obj;
+
+    bool same = true;
+    for (auto type_name : {"eosio::data::druid::Resource", "eosio::data::druid::Active"}) {
+        auto type = types().find_type(type_name);
+        if (!type) {
+            std::cerr << type_name << " is not registered" << std::endl;
+            return 1;
+        }
+        auto legacy = string(type_name) == "eosio::data::druid::Resource" ? legacy_resource : legacy_active;
+        for (auto& ttp : traces) {
+            vector<string> keys;
+            for (auto& kv : type->build(ttp, obj))
+                keys.push_back(kv.first);
+            if (keys != legacy(ttp)) {
+                std::cerr << type_name << " : keys differ for " << string(ttp->id) << std::endl;
+                same = false;
+                break;
+            }
+        }
+        double before = ns_per_trx(traces, rounds, [&](const transaction_trace_ptr& ttp) { return legacy(ttp).size(); });
+        double after = ns_per_trx(traces, rounds, [&](const transaction_trace_ptr& ttp) { return type->build(ttp, obj).size(); });
+        std::cout << type_name << " : " << traces.size() << " trxs, vector/string " << before / 1000 << " us/trx, "
+                  << "name set " << after / 1000 << " us/trx, speedup " << before / after << "x" << std::endl;
+    }
+    return same ? 0 : 1;
+}
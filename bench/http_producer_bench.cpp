@@ -0,0 +1,147 @@
+/**
+ * drives the registered HttpProducer against a local stand-in of the ingest sink.
+ *
+ * the stub answers {"status":0} after a configurable latency and fails a configurable share
+ * of the requests, so the retry path is exercised as well. every produced record carries a
+ * sequence number and the steady clock time when it was handed to the producer; the stub
+ * uses them to measure the end-to-end latency of the first successful delivery.
+ *
+ * options of the http producer (data-plugin-http-producer-*) are accepted as they are,
+ * the addr defaults to the stub.
+ */
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/data_plugin/producers.hpp>
+#include <eosio/data_plugin/file_output.hpp>
+#include "http_stub_sink.hpp"
+
+struct recorded_payload {
+    string name;
+    string key;
+    fc::variant value;
+};
+
+//the format written by FileProducer : name \t key \t json
+static vector<recorded_payload> load_payloads(const string& file_name) {
+    vector<recorded_payload> payloads;
+    std::ifstream file(file_name);
+    string line;
+    while (std::getline(file, line)) {
+        auto first = line.find('\t');
+        auto second = line.find('\t', first + 1);
+        if (first == string::npos || second == string::npos) continue;
+        payloads.push_back({line.substr(0, first), text_key::unescape(line.data() + first + 1, line.data() + second),
+                            fc::json::from_string(line.substr(second + 1))});
+    }
+    return payloads;
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description bench_options("http producer benchmark options");
+    bench_options.add_options()
+        ("help,h", "print this help message and exit")
+        ("requests", bpo::value<uint64_t>()->default_value(10000), "the number of records to produce")
+        ("payload-file", bpo::value<string>(), "records saved by FileProducer to replay, a synthetic record is used if not set")
+        ("port", bpo::value<uint16_t>()->default_value(18080), "the port the stub sink listens on")
+        ("latency-ms", bpo::value<uint32_t>()->default_value(0), "the time the stub sink waits before answering")
+        ("error-rate", bpo::value<double>()->default_value(0), "the share of requests the stub sink fails, between 0 and 1")
+        ("server-threads", bpo::value<uint32_t>()->default_value(2), "the number of threads of the stub sink")
+        ("timeout", bpo::value<uint32_t>()->default_value(300), "the max seconds to wait for all records to be delivered")
+        ("verbose", bpo::bool_switch()->default_value(false), "keep the log of the producer")
+    ;
+    auto producer = producers().find_producer("eosio::data::HttpProducer");
+    if (!producer) {
+        std::cerr << "HttpProducer is not registered" << std::endl;
+        return 1;
+    }
+    options_description producer_cli, producer_cfg("http producer options");
+    producer->set_program_options(producer_cli, producer_cfg);
+    options_description all_options;
+    all_options.add(bench_options).add(producer_cfg);
+
+    variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, all_options), options);
+    bpo::notify(options);
+    if (options.count("help")) {
+        std::cout << all_options << std::endl;
+        return 0;
+    }
+    auto port = options["port"].as<uint16_t>();
+    if (!options.count("data-plugin-http-producer-addr")) {
+        vector<string> addrs = {"http://127.0.0.1:" + std::to_string(port) + "/"};
+        options.insert(std::make_pair("data-plugin-http-producer-addr", bpo::variable_value(addrs, false)));
+    }
+    if (!options["verbose"].as<bool>())
+        fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+    vector<recorded_payload> payloads;
+    if (options.count("payload-file"))
+        payloads = load_payloads(options["payload-file"].as<string>());
+    if (payloads.empty()) {
+        payloads.push_back({"eosio.bench", "", fc::mutable_variant_object
+            ("transaction_id", "6c4bd48ec4fdcf4c5b4a67e0e9a41ce9ae5d5ec3c1bd35a65be7c1bbd1a2e8f0")
+            ("block_num", 32123456)
+            ("block_time", "2019-05-01T12:00:00.000")
+            ("from", "eosio")
+            ("to", "eosio.token")
+            ("amount", 1.0)
+            ("symbol", "EOS")
+            ("memo", string(200, 'm'))
+        });
+    }
+
+    stub_sink sink(port, options["latency-ms"].as<uint32_t>(), options["error-rate"].as<double>(),
+                   options["server-threads"].as<uint32_t>());
+    sink.start();
+    producer->initialize(options);
+    producer->startup();
+
+    auto total = options["requests"].as<uint64_t>();
+    auto begin = now_ns();
+    for (uint64_t i = 0; i < total; i ++) {
+        auto& payload = payloads[i % payloads.size()];
+        fc::mutable_variant_object obj;
+        if (payload.value.is_object())
+            obj = fc::mutable_variant_object(payload.value.get_object());
+        else
+            obj("value", payload.value);
+        obj("bench_seq", i)("bench_ts", now_ns());
+        fc::variant value(obj);
+        producer->produce(payload.name, payload.key.empty() ? std::to_string(i) : payload.key, value);
+    }
+    auto produced = now_ns();
+
+    auto deadline = produced + int64_t(options["timeout"].as<uint32_t>()) * 1000000000;
+    while (sink.delivered_num() < total && now_ns() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto end = now_ns();
+    producer->stop();
+    sink.stop();
+
+    auto delivered = sink.delivered_num();
+    auto& latencies = sink.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double q) -> double {
+        if (latencies.empty()) return 0;
+        size_t pos = std::min(latencies.size() - 1, size_t(latencies.size() * q));
+        return latencies[pos] / 1e6;
+    };
+    double seconds = (end - begin) / 1e9;
+    std::cout << "records produced   : " << total << " in " << (produced - begin) / 1e6 << " ms" << std::endl;
+    std::cout << "records delivered  : " << delivered << " in " << seconds * 1e3 << " ms" << std::endl;
+    std::cout << "throughput         : " << (seconds > 0 ? delivered / seconds : 0) << " requests/s" << std::endl;
+    std::cout << "latency ms         : p50=" << percentile(0.5) << " p99=" << percentile(0.99)
+              << " p999=" << percentile(0.999) << " max=" << percentile(1) << std::endl;
+    std::cout << "requests received  : " << sink.requests << std::endl;
+    std::cout << "injected errors    : " << sink.errors << std::endl;
+    std::cout << "retries            : " << sink.requests - delivered << std::endl;
+    std::cout << "sockets accepted   : " << sink.connections << std::endl;
+    return delivered == total ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/**
+ * checks that the queue in front of HttpProducer bounds what a stalled sink holds up.
+ *
+ * the stub sink reads the requests and never answers. records are produced through a
+ * producer_queue with the given capacity and policy, faster than the sink takes them. the
+ * run fails unless the producer holds at most capacity records, the sink saw at most
+ * capacity requests, block holds up the caller, the drop policies return at once, and the
+ * queue reports the producer as stalled.
+ *
+ * requests give up after max-wait, the producer stops once they did. options of the http
+ * producer (data-plugin-http-producer-*) are accepted as they are, the addr defaults to
+ * the stub.
+ */
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <fc/log/logger.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/data_plugin/producers.hpp>
+#include <eosio/data_plugin/producer_queue.hpp>
+#include "http_stub_sink.hpp"
+
+int main(int argc, char** argv) {
+    bpo::options_description check_options("http queue check options");
+    check_options.add_options()
+        ("help,h", "print this help message and exit")
+        ("records", bpo::value<uint32_t>()->default_value(2000), "the number of records to produce")
+        ("capacity", bpo::value<uint32_t>()->default_value(100), "the capacity of the producer queue")
+        ("policy", bpo::value<string>()->default_value("block"), "the policy of the producer queue : block, drop-newest or drop-oldest")
+        ("port", bpo::value<uint16_t>()->default_value(18081), "the port the stub sink listens on")
+        ("verbose", bpo::bool_switch()->default_value(false), "keep the log of the producer")
+    ;
+    auto producer = producers().find_producer("eosio::data::HttpProducer");
+    if (!producer) {
+        std::cerr << "HttpProducer is not registered" << std::endl;
+        return 1;
+    }
+    options_description producer_cli, producer_cfg("http producer options");
+    producer->set_program_options(producer_cli, producer_cfg);
+    options_description all_options;
+    all_options.add(check_options).add(producer_cfg);
+
+    variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, all_options), options);
+    if (options.count("help")) {
+        std::cout << all_options << std::endl;
+        return 0;
+    }
+    auto port = options["port"].as<uint16_t>();
+    if (!options.count("data-plugin-http-producer-addr")) {
+        vector<string> addrs = {"http://127.0.0.1:" + std::to_string(port) + "/"};
+        options.insert(std::make_pair("data-plugin-http-producer-addr", bpo::variable_value(addrs, false)));
+    }
+    //unless given, the requests give up soon after the check so that the producer can stop
+    for (auto& o : {std::make_pair("data-plugin-http-producer-max-wait", 3000u), std::make_pair("data-plugin-http-producer-try-num", 0u),
+                    std::make_pair("data-plugin-http-producer-retry-interval", 100u)}) {
+        if (!options[o.first].defaulted()) continue;
+        options.erase(o.first);
+        options.insert(std::make_pair(o.first, bpo::variable_value(o.second, false)));
+    }
+    bpo::notify(options);
+    if (!options["verbose"].as<bool>())
+        fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+    auto total = options["records"].as<uint32_t>();
+    auto capacity = options["capacity"].as<uint32_t>();
+    auto policy = options["policy"].as<string>();
+    //a latency of an hour is a sink which never answers
+    stub_sink sink(port, 3600 * 1000, 0, 1);
+    sink.start();
+    auto shared = producers().get_all_producers()["eosio::data::HttpProducer"];
+    producer_queue queue(shared, "http", producer_queue::options("capacity=" + std::to_string(capacity) + ";policy=" + policy + ";stall=1"));
+    queue.initialize(options);
+    queue.startup();
+
+    std::atomic<uint32_t> produced{0};
+    std::thread producing([&]() {
+        for (uint32_t i = 0; i < total; i ++) {
+            fc::variant value(fc::mutable_variant_object("bench_seq", i)("bench_ts", now_ns())("memo", string(200, 'm')));
+            queue.produce("eosio.check", std::to_string(i), value);
+            produced ++;
+        }
+    });
+    //well before max-wait, no request has given up yet
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    auto held = producer->memory_depth();
+    auto requests = uint64_t(sink.requests);
+    auto returned = uint32_t(produced);
+    auto health = queue.health();
+
+    bool ok = true;
+    auto check = [&](bool cond, const string& what) {
+        std::cout << (cond ? "ok     : " : "FAILED : ") << what << std::endl;
+        ok = ok && cond;
+    };
+    check(held <= capacity, "the producer holds " + std::to_string(held) + " records, capacity " + std::to_string(capacity));
+    check(requests <= capacity, "the sink saw " + std::to_string(requests) + " requests");
+    if (policy == "block")
+        check(returned < total, "block held up the caller after " + std::to_string(returned) + " of " + std::to_string(total) + " records");
+    else
+        check(returned == total, policy + " returned for all " + std::to_string(total) + " records");
+    check(health == producer_queue::stalled, string("the queue reports the producer as ") + producer_queue::health_name(health));
+
+    //stop lets the blocked caller go, the requests in flight give up after max-wait
+    queue.stop();
+    producing.join();
+    sink.stop();
+    return ok ? 0 : 1;
+}
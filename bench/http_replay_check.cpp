@@ -0,0 +1,154 @@
+/**
+ * checks that the retry queue of HttpProducer drains while new records keep coming.
+ *
+ * records are produced while the sink is down, so they all wait in the retry queue. the stub
+ * sink is then started with the given latency and records go on being produced at the given
+ * rate : as long as the queue is not empty they go to the end of it too. the run fails unless
+ * the backlog is delivered before the load stops, the queue is empty after it and the sink
+ * got every record.
+ *
+ * options of the http producer (data-plugin-http-producer-*) are accepted as they are, the
+ * addr defaults to the stub and the retry queue is on, in a temporary dir unless given.
+ */
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <iostream>
+#include <fc/log/logger.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/data_plugin/producers.hpp>
+#include "http_stub_sink.hpp"
+
+static fc::variant check_record(uint64_t seq) {
+    return fc::variant(fc::mutable_variant_object("bench_seq", seq)("bench_ts", now_ns())("memo", string(200, 'm')));
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description check_options("http replay check options");
+    check_options.add_options()
+        ("help,h", "print this help message and exit")
+        ("backlog", bpo::value<uint32_t>()->default_value(20000), "the records produced while the sink is down")
+        ("rate", bpo::value<uint32_t>()->default_value(2000), "the records per second produced once the sink is up")
+        ("load-seconds", bpo::value<uint32_t>()->default_value(20), "how long records are produced once the sink is up")
+        ("latency-ms", bpo::value<uint32_t>()->default_value(5), "the time the stub sink waits before answering")
+        ("port", bpo::value<uint16_t>()->default_value(18082), "the port the stub sink listens on")
+        ("timeout", bpo::value<uint32_t>()->default_value(60), "the max seconds to wait for all records to be delivered")
+        ("verbose", bpo::bool_switch()->default_value(false), "keep the log of the producer")
+    ;
+    auto producer = producers().find_producer("eosio::data::HttpProducer");
+    if (!producer) {
+        std::cerr << "HttpProducer is not registered" << std::endl;
+        return 1;
+    }
+    options_description producer_cli, producer_cfg("http producer options");
+    producer->set_program_options(producer_cli, producer_cfg);
+    options_description all_options;
+    all_options.add(check_options).add(producer_cfg);
+
+    variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, all_options), options);
+    if (options.count("help")) {
+        std::cout << all_options << std::endl;
+        return 0;
+    }
+    auto port = options["port"].as<uint16_t>();
+    if (!options.count("data-plugin-http-producer-addr")) {
+        vector<string> addrs = {"http://127.0.0.1:" + std::to_string(port) + "/"};
+        options.insert(std::make_pair("data-plugin-http-producer-addr", bpo::variable_value(addrs, false)));
+    }
+    auto queue_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("http-replay-check-%%%%%%%%");
+    bool temporary = options["data-plugin-http-producer-retry-queue-dir"].defaulted();
+    //unless given, a request gives up at once and the queue is replayed often
+    for (auto& o : {std::make_pair("data-plugin-http-producer-try-num", 0u), std::make_pair("data-plugin-http-producer-retry-interval", 10u),
+                    std::make_pair("data-plugin-http-producer-replay-interval", 200u)}) {
+        if (!options[o.first].defaulted()) continue;
+        options.erase(o.first);
+        options.insert(std::make_pair(o.first, bpo::variable_value(o.second, false)));
+    }
+    options.erase("data-plugin-http-producer-retry-queue");
+    options.insert(std::make_pair("data-plugin-http-producer-retry-queue", bpo::variable_value(true, false)));
+    if (temporary) {
+        options.erase("data-plugin-http-producer-retry-queue-dir");
+        options.insert(std::make_pair("data-plugin-http-producer-retry-queue-dir", bpo::variable_value(queue_dir.string(), false)));
+    }
+    bpo::notify(options);
+    if (!options["verbose"].as<bool>())
+        fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+    auto backlog = options["backlog"].as<uint32_t>();
+    auto rate = std::max(1u, options["rate"].as<uint32_t>());
+    auto load_seconds = options["load-seconds"].as<uint32_t>();
+    producer->initialize(options);
+    producer->startup();
+    //what waits on disk, the rest is held in memory
+    auto waiting = [&]() {
+        auto held = producer->memory_depth();
+        auto depth = producer->queue_depth();
+        return depth > held ? depth - held : 0;
+    };
+
+    //the sink is down, every record ends up in the retry queue
+    uint64_t seq = 0;
+    for (; seq < backlog; seq ++) {
+        //a few at a time, each failed request holds a socket until it gives up
+        while (producer->memory_depth() > 256)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto value = check_record(seq);
+        producer->produce("eosio.check", std::to_string(seq), value);
+    }
+    while (producer->memory_depth() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto queued = waiting();
+
+    std::unique_ptr<stub_sink> sink(new stub_sink(port, options["latency-ms"].as<uint32_t>(), 0, 2));
+    sink->start();
+    auto started = std::chrono::steady_clock::now();
+    std::atomic<bool> loading{true};
+    std::thread load([&]() {
+        auto next = std::chrono::steady_clock::now();
+        auto end = next + std::chrono::seconds(load_seconds);
+        while (next < end) {
+            auto value = check_record(seq);
+            producer->produce("eosio.check", std::to_string(seq), value);
+            seq ++;
+            next += std::chrono::microseconds(1000000 / rate);
+            std::this_thread::sleep_until(next);
+        }
+        loading = false;
+    });
+    //the backlog has to get through while the load goes on
+    double caught_up = -1;
+    while (loading) {
+        if (sink->delivered_below(backlog) == backlog) {
+            caught_up = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    load.join();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options["timeout"].as<uint32_t>());
+    while ((sink->delivered_num() < seq || waiting() > 0) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto delivered = sink->delivered_num();
+    auto left = waiting();
+
+    bool ok = true;
+    auto check = [&](bool cond, const string& what) {
+        std::cout << (cond ? "ok     : " : "FAILED : ") << what << std::endl;
+        ok = ok && cond;
+    };
+    check(queued == backlog, std::to_string(queued) + " of " + std::to_string(backlog) + " records waited in the retry queue while the sink was down");
+    check(caught_up >= 0, caught_up >= 0 ? "the backlog was delivered " + std::to_string(caught_up) + "s after the sink came up, under " + std::to_string(rate) + " records/s"
+                                         : "the backlog was not delivered in " + std::to_string(load_seconds) + "s under " + std::to_string(rate) + " records/s");
+    check(left == 0, "the retry queue holds " + std::to_string(left) + " records once the load stopped");
+    check(delivered == seq, "the sink got " + std::to_string(delivered) + " of " + std::to_string(seq) + " records over "
+                            + std::to_string(uint64_t(sink->connections)) + " connections");
+
+    producer->stop();
+    sink->stop();
+    if (temporary)
+        boost::filesystem::remove_all(queue_dir);
+    return ok ? 0 : 1;
+}
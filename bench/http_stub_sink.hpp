@@ -0,0 +1,193 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <boost/asio.hpp>
+#include <fc/io/json.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <eosio/data_plugin/compressor.hpp>
+
+/**
+ * a local stand-in of the ingest sink of HttpProducer, shared by the http benchmarks.
+ * it answers {"status":0} after a configurable latency and fails a configurable share of the
+ * requests. requests pipelined on one connection wait their latency side by side and are
+ * answered in order. records carrying bench_seq and bench_ts are counted once as delivered,
+ * with the latency from bench_ts.
+ */
+
+using namespace eosio::data;
+using std::vector;
+using std::shared_ptr;
+using boost::asio::ip::tcp;
+using boost::asio::io_service;
+namespace http = boost::beast::http;
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct stub_sink {
+    stub_sink(uint16_t port, uint32_t latency_ms, double error_rate, uint32_t threads)
+        : acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port))
+        , latency_ms(latency_ms), error_rate(error_rate), thread_num(threads) {}
+
+    //requests pipelined on a connection are read at once, each is answered in order once its latency passed
+    struct session : std::enable_shared_from_this<session> {
+        session(stub_sink& sink, tcp::socket socket)
+            : sink(sink), socket(std::move(socket)) {}
+
+        struct exchange {
+            http::request<http::string_body> request;
+            http::response<http::string_body> response;
+            int64_t received = 0;
+            bool ready = false;
+        };
+
+        void read() {
+            auto self = shared_from_this();
+            auto ex = std::make_shared<exchange>();
+            http::async_read(socket, buffer, ex->request, boost::asio::bind_executor(strand, [self, ex](const boost::system::error_code& error, std::size_t) {
+                if (error) return;
+                ex->received = now_ns();
+                self->sink.requests ++;
+                self->exchanges.push_back(ex);
+                if (self->sink.latency_ms == 0) {
+                    self->respond(*ex);
+                } else {
+                    auto timer = std::make_shared<boost::asio::steady_timer>(self->sink.io, std::chrono::milliseconds(self->sink.latency_ms));
+                    timer->async_wait(boost::asio::bind_executor(self->strand, [self, ex, timer](const boost::system::error_code&) {
+                        self->respond(*ex);
+                    }));
+                }
+                if (ex->request.keep_alive())
+                    self->read();
+            }));
+        }
+
+        void respond(exchange& ex) {
+            static thread_local std::mt19937 rng(std::random_device{}());
+            bool fail = std::uniform_real_distribution<double>(0, 1)(rng) < sink.error_rate;
+            auto& response = ex.response;
+            response.version(ex.request.version());
+            response.keep_alive(ex.request.keep_alive());
+            response.set(http::field::content_type, "application/json");
+            if (fail) {
+                sink.errors ++;
+                response.result(http::status::internal_server_error);
+                response.body() = "{\"status\":1}";
+            } else {
+                sink.record(ex.request, ex.received);
+                response.result(http::status::ok);
+                response.body() = "{\"status\":0}";
+            }
+            response.prepare_payload();
+            ex.ready = true;
+            write();
+        }
+
+        //the oldest answer once it is ready, one write at a time
+        void write() {
+            if (writing || exchanges.empty() || !exchanges.front()->ready) return;
+            writing = true;
+            auto self = shared_from_this();
+            auto ex = exchanges.front();
+            http::async_write(socket, ex->response, boost::asio::bind_executor(strand, [self, ex](const boost::system::error_code& error, std::size_t) {
+                self->writing = false;
+                if (error) return;
+                self->exchanges.pop_front();
+                if (!ex->response.keep_alive()) {
+                    boost::system::error_code ec;
+                    self->socket.shutdown(tcp::socket::shutdown_send, ec);
+                    return;
+                }
+                self->write();
+            }));
+        }
+
+        stub_sink& sink;
+        tcp::socket socket;
+        boost::beast::flat_buffer buffer;
+        std::deque<shared_ptr<exchange> > exchanges;
+        bool writing = false;
+        //the handlers of a connection run one at a time whatever the sink threads
+        boost::asio::io_service::strand strand{sink.io};
+    };
+
+    void start() {
+        accept();
+        for (uint32_t i = 0; i < thread_num; i ++)
+            threads.emplace_back([this](){ io.run(); });
+    }
+
+    void stop() {
+        io.stop();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void accept() {
+        auto socket = std::make_shared<tcp::socket>(io);
+        acceptor.async_accept(*socket, [this, socket](const boost::system::error_code& error) {
+            if (!error) {
+                connections ++;
+                std::make_shared<session>(*this, std::move(*socket))->read();
+            }
+            accept();
+        });
+    }
+
+    void record(const http::request<http::string_body>& request, int64_t received) {
+        static thread_local compressor decoder;
+        try {
+            string body;
+            auto encoding = request[http::field::content_encoding];
+            decoder.decompress(compressor::parse_codec(string(encoding.data(), encoding.size())), request.body(), body);
+            auto data = fc::json::from_string(body).get_object()["data"].get_object();
+            auto seq = data["bench_seq"].as_uint64();
+            auto sent = data["bench_ts"].as_int64();
+            std::lock_guard<std::mutex> lock(mtx);
+            if (delivered.insert(seq).second)
+                latencies.push_back(received - sent);
+        } catch (const std::exception& ex) {
+            std::cerr << "stub sink : bad request body : " << ex.what() << std::endl;
+        } catch (const fc::exception& ex) {
+            std::cerr << "stub sink : bad request body : " << ex.to_string() << std::endl;
+        }
+    }
+
+    size_t delivered_num() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return delivered.size();
+    }
+
+    //the records delivered among the first num ones
+    size_t delivered_below(uint64_t num) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return std::count_if(delivered.begin(), delivered.end(), [num](uint64_t seq) { return seq < num; });
+    }
+
+    io_service io;
+    tcp::acceptor acceptor;
+    uint32_t latency_ms;
+    double error_rate;
+    uint32_t thread_num;
+    vector<std::thread> threads;
+
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> errors{0};
+    std::mutex mtx;
+    std::unordered_set<uint64_t> delivered;
+    vector<int64_t> latencies;
+};
@@ -0,0 +1,206 @@
+/**
+ * checks the token transfer fast path against the abi : every transfer is read from its raw
+ * action data with unpack_token_transfer and decoded with the eosio.token abi, where the fast
+ * path takes a payload both must give the same transfer, the run fails otherwise.
+ *
+ * transfers are either synthetic, well formed ones with random accounts, symbols and memos
+ * plus payloads the fast path has to leave to the abi (trailing bytes, cut short, invalid
+ * symbol), or recorded : FileProducer lines of a struct holding whole traces, like
+ * hbase.transactiontrace ({"json": "<trace>"}), whose transfer actions carry hex_data.
+ * recorded transfers are also compared with the data the node decoded.
+ */
+#include <random>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/data_plugin/token_action.hpp>
+
+using namespace eosio::chain;
+using namespace eosio::data;
+using std::vector;
+namespace bpo = boost::program_options;
+
+struct token_sample {
+    action act;
+    //the fast path should take the payload
+    bool expected;
+    //the data decoded by the node, null if not recorded
+    fc::variant recorded;
+};
+
+struct check_result {
+    uint64_t fast = 0;
+    uint64_t abi_only = 0;
+    uint64_t mismatches = 0;
+};
+
+static abi_serializer token_abi(const fc::microseconds& max_time) {
+    abi_def abi;
+    abi.version = "eosio::abi/1.0";
+    abi.types.push_back({"account_name", "name"});
+    abi.structs.push_back({"transfer", "", {{"from", "account_name"}, {"to", "account_name"}, {"quantity", "asset"}, {"memo", "string"}}});
+    abi.actions.push_back({N(transfer), "transfer", ""});
+    return abi_serializer(abi, max_time);
+}
+
+static name random_name(std::mt19937_64& rng) {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz12345";
+    string s;
+    for (int i = 0, n = 1 + rng() % 12; i < n; i ++)
+        s += chars[rng() % 31];
+    return name(s);
+}
+
+static string random_memo(std::mt19937_64& rng) {
+    string memo;
+    for (int i = 0, n = rng() % 4 == 0 ? 0 : rng() % 300; i < n; i ++)
+        memo += char(rng() % 256);
+    return memo;
+}
+
+//the transfer layout with a raw symbol, so the symbol does not have to be valid
+struct raw_transfer {
+    name     from;
+    name     to;
+    int64_t  amount;
+    uint64_t sym;
+    string   memo;
+};
+
+FC_REFLECT(raw_transfer, (from)(to)(amount)(sym)(memo))
+
+static bytes pack_transfer(const name& from, const name& to, int64_t amount, uint64_t sym, const string& memo) {
+    return fc::raw::pack(raw_transfer{from, to, amount, sym, memo});
+}
+
+static vector<token_sample> synthetic_transfers(uint32_t num) {
+    static const char* codes[] = {"EOS", "SYS", "USDT", "A", "ABCDEFG"};
+    std::mt19937_64 rng(42);
+    vector<token_sample> samples;
+    for (uint32_t i = 0; i < num; i ++) {
+        symbol sym(rng() % 19, codes[rng() % 5]);
+        auto amount = int64_t(rng() % asset::max_amount) * (rng() % 8 == 0 ? -1 : 1);
+        token_sample sample{action(), true, fc::variant()};
+        sample.act.account = N(eosio.token);
+        sample.act.name = N(transfer);
+        sample.act.data = pack_transfer(random_name(rng), random_name(rng), amount, sym.value(), random_memo(rng));
+        switch (i % 8) {
+            case 5:
+                sample.act.data.push_back(0);
+                sample.expected = false;
+                break;
+            case 6:
+                sample.act.data.resize(rng() % sample.act.data.size());
+                sample.expected = false;
+                break;
+            case 7:
+                //a lowercase symbol code
+                sample.act.data = pack_transfer(random_name(rng), random_name(rng), amount, (sym.value() & 0xff) | (uint64_t('e') << 8), string());
+                sample.expected = false;
+                break;
+        }
+        samples.push_back(std::move(sample));
+    }
+    return samples;
+}
+
+static void load_transfers(const fc::variant_object& trace, vector<token_sample>& samples) {
+    auto& act = trace["act"].get_object();
+    if (act["name"].as<name>() == N(transfer) && act.contains("hex_data")) {
+        token_sample sample{action(), true, act["data"]};
+        sample.act.account = act["account"].as<name>();
+        sample.act.name = N(transfer);
+        sample.act.data = act["hex_data"].as<bytes>();
+        samples.push_back(std::move(sample));
+    }
+    if (trace.contains("inline_traces"))
+        for (auto& inline_trace : trace["inline_traces"].get_array())
+            load_transfers(inline_trace.get_object(), samples);
+}
+
+static vector<token_sample> recorded_transfers(const string& file_name) {
+    vector<token_sample> samples;
+    std::ifstream file(file_name);
+    string line;
+    while (std::getline(file, line)) {
+        auto second = line.find('\t', line.find('\t') + 1);
+        if (second == string::npos) continue;
+        try {
+            auto value = fc::json::from_string(line.substr(second + 1));
+            if (value.get_object().contains("json"))
+                value = fc::json::from_string(value["json"].as_string());
+            auto& obj = value.get_object();
+            if (!obj.contains("action_traces")) continue;
+            for (auto& trace : obj["action_traces"].get_array())
+                load_transfers(trace.get_object(), samples);
+        } catch (const fc::exception& ex) {
+            continue;
+        }
+    }
+    return samples;
+}
+
+static check_result check(const vector<token_sample>& samples, const abi_serializer& abi, const fc::microseconds& max_time) {
+    check_result res;
+    for (auto& sample : samples) {
+        token_transfer transfer;
+        bool fast = unpack_token_transfer(sample.act, transfer);
+        fc::variant decoded;
+        try {
+            decoded = abi.binary_to_variant("transfer", sample.act.data, max_time);
+        } catch (const fc::exception& ex) {
+        }
+        string reason;
+        if (fast && !sample.expected)
+            reason = "the fast path took a payload it should leave to the abi";
+        else if (!fast && sample.expected && sample.recorded.is_null())
+            reason = "the fast path left a well formed payload to the abi";
+        else if (fast && !same_token_transfer(decoded, transfer))
+            reason = "the fast path differs from the abi";
+        else if (fast && !sample.recorded.is_null() && !same_token_transfer(sample.recorded, transfer))
+            reason = "the fast path differs from the data decoded by the node";
+        if (!reason.empty()) {
+            std::cerr << reason << " : " << string(sample.act.account) << " " << fc::to_hex(sample.act.data) << std::endl;
+            if (fast) std::cerr << "  fast : " << fc::json::to_string(fc::variant(transfer)) << std::endl;
+            std::cerr << "  abi  : " << fc::json::to_string(decoded) << std::endl;
+            res.mismatches ++;
+        }
+        if (fast) res.fast ++;
+        else res.abi_only ++;
+    }
+    return res;
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description options_desc("token decode check options");
+    options_desc.add_options()
+        ("help,h", "print this help message and exit")
+        ("trace-file", bpo::value<string>(), "FileProducer output with whole transaction traces, synthetic transfers if not set")
+        ("transfers", bpo::value<uint32_t>()->default_value(100000), "synthetic : the number of transfers")
+    ;
+    bpo::variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, options_desc), options);
+    bpo::notify(options);
+    if (options.count("help")) {
+        std::cout << options_desc << std::endl;
+        return 0;
+    }
+    fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+    auto samples = options.count("trace-file")
+        ? recorded_transfers(options["trace-file"].as<string>())
+        : synthetic_transfers(options["transfers"].as<uint32_t>());
+    if (samples.empty()) {
+        std::cerr << "no transfer to check" << std::endl;
+        return 1;
+    }
+    auto max_time = fc::seconds(10);
+    auto res = check(samples, token_abi(max_time), max_time);
+    std::cout << samples.size() << " transfers : " << res.fast << " on the fast path, " << res.abi_only << " left to the abi, "
+              << res.mismatches << " mismatches" << std::endl;
+    return res.mismatches ? 1 : 0;
+}
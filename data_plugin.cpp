@@ -2,6 +2,9 @@
 #include <eosio/data_plugin/data_plugin.hpp>
 #include <eosio/data_plugin/producers.hpp>
 #include <eosio/data_plugin/types.hpp>
+#include <eosio/data_plugin/metrics.hpp>
+#include <eosio/data_plugin/block_range.hpp>
+#include <eosio/data_plugin/producer_queue.hpp>
 
 namespace eosio {
 
@@ -14,9 +17,29 @@ void data_plugin::set_program_options(options_description& cli, options_descript
     cfg.add_options()
         ("data-plugin-start-num", bpo::value<uint32_t>()->default_value(0),   "when will start")
         ("data-plugin-stop-num",  bpo::value<uint32_t>()->default_value(-1),  "when will stop, for test")
+        ("data-plugin-range",     bpo::value<vector<string> >()->composing(), "the blocks to build records for as first-last or first- for no end, can have more than one, replaces data-plugin-start-num and data-plugin-stop-num. nodeos quits once the last block is irreversible")
         ("data-plugin-struct",    bpo::value<vector<string> >()->composing(), "which struct will be record, can have more than one")
         ("data-plugin-producer",  bpo::value<vector<string> >()->composing(), "which producer will be used, can have more than one")
+        ("data-plugin-producer-isolation", bpo::value<bool>()->default_value(true), "give every producer of data-plugin-producer its own bounded queue and thread so a slow one does not hold up the others, a producer added by a reload runs without")
+        ("data-plugin-producer-queue", bpo::value<vector<string> >()->composing(), "the queue of a producer as producer=capacity=100000;policy=block|drop-newest|drop-oldest;stall=30, capacity 0 to call it directly. block waits for room and holds up the chain thread, the drop policies lose records")
+        ("data-plugin-struct-file", bpo::value<vector<string> >()->composing(), "json file of structs defined without c++, relative to the config dir, can have more than one")
         ("data-plugin-prefix",    bpo::value<string>()->default_value("eosio"),"the prefix of all data struct name")
+        ("data-plugin-table-suffix", bpo::value<vector<string> >()->composing(), "the table_suffix granularity of a struct as struct=month|day|hour, month if not set")
+        ("data-plugin-key-format", bpo::value<vector<string> >()->composing(), "the action and transaction key format of a struct as struct=legacy|text|binary, legacy if not set")
+        ("data-plugin-payload-format", bpo::value<vector<string> >()->composing(), "how the hbase structs store whole blocks and traces as struct=json|binary, json if not set. binary is base64 of fc::raw. newhbase::BlockState keeps one row per block, with binary its irreversible event only sets info:irreversible on the row written when it was accepted")
+        ("data-plugin-aggregate", bpo::value<vector<string> >()->composing(), "roll up the records of a struct into tumbling windows, produced as <name>.agg when the irreversible block passes the window end. struct=window=60;dims=actor,receiver;metrics=count,sum:cpu_usage_us,distinct:trx. needs data-plugin-fork-mode=irreversible-only")
+        ("data-plugin-key-salt-buckets", bpo::value<uint32_t>()->default_value(0), "text and binary keys start with a salt byte in [0, buckets) to spread the writes, 0 means no salt")
+        ("data-plugin-fields", bpo::value<vector<string> >()->composing(), "the fields the records of a struct keep as struct=include:a,b.c or struct=exclude:a,b, paths select inside the stored object for the hbase structs")
+        ("data-plugin-limit", bpo::value<vector<string> >()->composing(), "build only some events of a struct as struct=sample=0.01;rate=500;burst=2000. sample keeps the transactions and blocks whose id hashes under the fraction, rate and burst are a token bucket of records per second. checked before anything is built")
+        ("data-plugin-fields-sample", bpo::value<uint32_t>()->default_value(1000), "one record in this many is built whole to log the bytes data-plugin-fields saves, 0 to never measure")
+        ("data-plugin-token-fast-path", bpo::value<bool>()->default_value(true), "read token transfers from the raw action data instead of the abi decoded json")
+        ("data-plugin-token-verify", bpo::value<bool>()->default_value(false), "decode token transfers both ways and log where the raw data and the abi disagree")
+        ("data-plugin-hot-reload", bpo::value<bool>()->default_value(true), "read data-plugin-struct, data-plugin-producer, data-plugin-limit and data-plugin-fields again from config.ini on SIGHUP, the new ones apply from the next block. what the command line set is kept")
+        ("data-plugin-fork-mode", bpo::value<string>()->default_value("all"), "all : produce every event as it comes, irreversible-only : hold records until their block is irreversible, reversible+retract : produce records when their block is accepted and <name>.retract records for the blocks forked out. transactions only go out with the block including them, once")
+        ("data-plugin-metrics-interval", bpo::value<uint32_t>()->default_value(0), "log the records, bytes and latencies of every struct and producer every this many seconds, 0 to turn the metrics off")
+        ("data-plugin-metrics-sample", bpo::value<uint32_t>()->default_value(16), "one event in this many is timed and measured for the metrics")
+        ("data-plugin-checkpoint-interval", bpo::value<uint32_t>()->default_value(100), "save the last irreversible block every producer delivered to data-plugin-checkpoint.json in the data dir every this many blocks, 0 to never save")
+        ("data-plugin-resume", bpo::value<bool>()->default_value(true), "start after the checkpoint of the producers when it is past data-plugin-start-num")
         ("data-plugin-register-accepted-block", bpo::value<bool>()->default_value(true), "if register callback on accepted block")
         ("data-plugin-register-irreversible-block", bpo::value<bool>()->default_value(true), "if register callback on irreversible block")
         ("data-plugin-register-applied-transaction", bpo::value<bool>()->default_value(true), "if register callback on applied transaction")
@@ -24,72 +47,286 @@ void data_plugin::set_program_options(options_description& cli, options_descript
         ;
 }
 
+using eosio::data::fork_buffer;
+using eosio::data::dispatch_metrics;
+
+static const char* event_name(const block_state_ptr&)        { return "block"; }
+static const char* event_name(const transaction_trace_ptr&)  { return "transaction_trace"; }
+static const char* event_name(const transaction_metadata_ptr&) { return "transaction_metadata"; }
+
+static const fc::sha256& event_id(const block_state_ptr& bsp)          { return bsp->id; }
+static const fc::sha256& event_id(const transaction_trace_ptr& ttp)    { return ttp->id; }
+static const fc::sha256& event_id(const transaction_metadata_ptr& tmp) { return tmp->id; }
+
 template <class T>
-void callback(const vector<string>& types, const vector<string>& producers, const T& t, fc::optional<bool> irreversible = fc::optional<bool>()) {
+fork_buffer::records build_records(const vector<string>& types, const T& t, fc::optional<bool> irreversible = fc::optional<bool>()) {
+    //the structs whose limit lets the event through, nothing is converted for none
+    vector<eosio::data::abstract_type*> admitted;
+    for (string tname : types) {
+        auto type = eosio::data::types().find_type(tname);
+        if (!type) continue;
+        if (type->limit && !type->limit->admit(event_id(t))) continue;
+        admitted.push_back(type);
+    }
+    if (admitted.empty()) return fork_buffer::records();
+    auto& metrics = eosio::data::metrics();
+    bool timed = metrics.sample_event();
+    uint64_t begin = timed ? dispatch_metrics::now_ns() : 0;
     auto tvariant = app().get_plugin<chain_plugin>()
                         .chain().to_variant_with_abi(t, fc::seconds(10));
+    uint64_t to_variant_ns = timed ? dispatch_metrics::now_ns() - begin : 0;
     fc::mutable_variant_object tobject = tvariant.get_object();
+    //a new event for the flattened trace shared by the structs
+    ++eosio::data::trace_event_seq();
     if (irreversible)
         tobject.set("irreversible", *irreversible);
+    fork_buffer::records records;
+    for (auto type : admitted) {
+        //one record in sample is built whole and measured against its projection
+        auto& sampling = eosio::data::field_projection::sampling();
+        auto projection = type->projection;
+        sampling = projection && projection->sample && ++projection->records % projection->sample == 0;
+        begin = timed ? dispatch_metrics::now_ns() : 0;
+        auto datum = type->build(t, tobject);
+        if (type->limit)
+            type->limit->consume(datum.size());
+        if (projection && !type->whole_object()) {
+            for (auto& data : datum) {
+                auto projected = projection->apply(data.second);
+                if (sampling)
+                    projection->measure(eosio::data::field_projection::json_size(data.second),
+                                        eosio::data::field_projection::json_size(projected), type->name);
+                data.second = std::move(projected);
+            }
+        }
+        sampling = false;
+        if (metrics.enabled) {
+            auto build_ns = timed ? dispatch_metrics::now_ns() - begin : 0;
+            auto& shard = metrics.local();
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto& counters = shard.types[type->name];
+            counters.events ++;
+            counters.records += datum.size();
+            if (timed) {
+                counters.build.add(build_ns);
+                for (auto& data : datum)
+                    counters.sampled_bytes += eosio::data::field_projection::json_size(data.second);
+                counters.sampled_records += datum.size();
+            }
+        }
+        for (auto& data : datum)
+            records.push_back({type, type->name, std::move(data.first), std::move(data.second)});
+    }
+    if (metrics.enabled) {
+        auto& shard = metrics.local();
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.events ++;
+        if (timed)
+            shard.to_variant[event_name(t)].add(to_variant_ns);
+    }
+    return records;
+}
+//aggregated structs roll their records up, a retraction cannot be taken out of a window
+void produce_records(const vector<string>& producers, fork_buffer::records records) {
+    auto& metrics = eosio::data::metrics();
+    //one record of a sampled event is timed producer by producer
+    size_t timed = metrics.enabled && !records.empty() && metrics.sample_event() ? records.size() / 2 : records.size();
+    vector<uint64_t> produce_ns(producers.size(), 0);
+    for (size_t r = 0; r < records.size(); r ++) {
+        auto& record = records[r];
+        if (record.type->aggregator) {
+            if (record.name == record.type->name)
+                record.type->aggregator->add(record.value);
+            continue;
+        }
+        for (size_t i = 0; i < producers.size(); i ++) {
+            auto producer = eosio::data::producers().find_producer(producers[i]);
+            if (!producer) continue;
+            auto begin = r == timed ? dispatch_metrics::now_ns() : 0;
+            producer->produce(record.name, record.key, record.value);
+            if (r == timed)
+                produce_ns[i] = dispatch_metrics::now_ns() - begin;
+        }
+    }
+    if (!metrics.enabled || records.empty()) return;
+    auto& shard = metrics.local();
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    for (size_t i = 0; i < producers.size(); i ++) {
+        auto& counters = shard.producers[producers[i]];
+        counters.records += records.size();
+        if (timed < records.size() && produce_ns[i])
+            counters.produce.add(produce_ns[i]);
+    }
+}
+template <class T>
+void callback(const vector<string>& types, const vector<string>& producers, const T& t, fc::optional<bool> irreversible = fc::optional<bool>()) {
+    produce_records(producers, build_records(types, t, irreversible));
+};
+//onblock is applied in every block without a receipt in it
+static bool implicit_transaction(const transaction_trace_ptr& ttp) {
+    return ttp->action_traces.size() == 1
+        && ttp->action_traces[0].act.account == config::system_account_name
+        && ttp->action_traces[0].act.name == N(onblock);
+}
+//produce the aggregated windows which are complete
+void flush_aggregators(const vector<string>& types, const vector<string>& producers, fc::optional<fc::time_point> irreversible_time) {
     for (string tname : types) {
         auto type = eosio::data::types().find_type(tname);
-        if (!type) continue;
-        auto datum = type->build(t, tobject);
+        if (!type || !type->aggregator) continue;
+        auto datum = irreversible_time ? type->aggregator->flush(*irreversible_time) : type->aggregator->flush_all();
         for (auto data : datum) {
             for (auto pname : producers) {
                 auto producer = eosio::data::producers().find_producer(pname);
                 if (!producer) continue;
-                producer->produce(type->name, data.first, data.second);
+                producer->produce(type->name + ".agg", data.first, data.second);
             }
         }
     }
-};
+}
 void data_plugin::plugin_initialize(const variables_map& options) {
     ilog("Initialize data plugin");
     for (auto producer : eosio::data::producers().get_all_producers()) {
         producer.second->initialize(options);
     }
-    start_block_num = options.at("data-plugin-start-num").as<uint32_t>();
-    stop_block_num = options.at("data-plugin-stop-num").as<uint32_t>();
-    types = options.at("data-plugin-struct").as<vector<string> >();
-    for (auto type : types) {
-        if (!eosio::data::types().find_type(type)) 
-            wlog ("data-plugin initialize warnning : type ${type} not found", ("type", type));
+    if (options.at("data-plugin-producer-isolation").as<bool>()) {
+        std::map<string, string> queue_specs;
+        if (options.count("data-plugin-producer-queue")) {
+            for (auto queue : options.at("data-plugin-producer-queue").as<vector<string> >()) {
+                auto pos = queue.find('=');
+                FC_ASSERT(pos != string::npos, "data-plugin-producer-queue should be producer=spec : ${q}", ("q", queue));
+                FC_ASSERT(eosio::data::producers().find_producer(queue.substr(0, pos)), "data-plugin-producer-queue for unknown producer : ${q}", ("q", queue));
+                queue_specs[queue.substr(0, pos)] = queue.substr(pos + 1);
+            }
+        }
+        //the registered producer is kept behind its queue, started and stopped through it. only the
+        //producers in use are, one enabled later by a reload is called directly from the chain thread
+        auto in_use = options.at("data-plugin-producer").as<vector<string> >();
+        for (auto& producer : eosio::data::producers().get_all_producers()) {
+            if (std::find(in_use.begin(), in_use.end(), producer.first) == in_use.end()) continue;
+            eosio::data::producer_queue::options queue_options(queue_specs[producer.first]);
+            if (!queue_options.capacity) continue;
+            producer.second = std::make_shared<eosio::data::producer_queue>(producer.second, producer.first, queue_options);
+        }
     }
-    producers = options.at("data-plugin-producer").as<vector<string> >();
-    for (auto producer : producers) {
-        if (!eosio::data::producers().find_producer(producer))
-            wlog ("data-plugin initialize warnning : producer ${producer not found",
-                    ("producer", producer));
+    if (options.count("data-plugin-struct-file")) {
+        for (auto file : options.at("data-plugin-struct-file").as<vector<string> >()) {
+            fc::path path(file);
+            if (path.is_relative())
+                path = app().config_dir() / path;
+            eosio::data::load_declared_types(path);
+        }
+    }
+    if (options.count("data-plugin-range")) {
+        ranges = eosio::data::block_ranges::parse(options.at("data-plugin-range").as<vector<string> >());
+    } else {
+        auto start_block_num = options.at("data-plugin-start-num").as<uint32_t>();
+        auto stop_block_num = options.at("data-plugin-stop-num").as<uint32_t>();
+        ranges = eosio::data::block_ranges();
+        //a stop before the start never stopped
+        if (start_block_num)
+            ranges.start_after(start_block_num - 1);
+        if (stop_block_num > start_block_num && stop_block_num != UINT32_MAX)
+            ranges = eosio::data::block_ranges::parse({std::to_string(start_block_num) + "-" + std::to_string(stop_block_num)});
     }
     current_block_num = 0;
+    stopping = false;
+
+    checkpoint_interval = options.at("data-plugin-checkpoint-interval").as<uint32_t>();
+    checkpoint = eosio::data::checkpoint_file(app().data_dir() / "data-plugin-checkpoint.json");
+    checkpoint_positions = checkpoint.load();
+    if (options.at("data-plugin-resume").as<bool>() && !checkpoint_positions.empty()) {
+        auto after = eosio::data::checkpoint_file::resume_after(checkpoint_positions, options.at("data-plugin-producer").as<vector<string> >());
+        if (after && !ranges.ranges.empty() && after >= ranges.ranges.front().first) {
+            ilog ("data-plugin resumes after block ${n} from ${p}", ("n", after)("p", checkpoint.path.string()));
+            ranges.start_after(after);
+        }
+    }
     
     string prefix = options.at("data-plugin-prefix").as<string>();
-    for (auto type : eosio::data::types().get_all_types()) {
-        string dest_name = type.first;
-        constexpr char replace_from[] = "::";
-        constexpr char replace_to[] = ".";
-        string::size_type pos = dest_name.find(replace_from);
-        while (pos != string::npos) {
-            dest_name = dest_name.replace(pos, sizeof(replace_from) - 1, replace_to);
-            pos = dest_name.find(replace_from);
+    eosio::data::types().set_prefix(prefix);
+    if (options.count("data-plugin-table-suffix")) {
+        for (auto suffix : options.at("data-plugin-table-suffix").as<vector<string> >()) {
+            auto pos = suffix.rfind('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-table-suffix should be struct=granularity : ${s}", ("s", suffix));
+            auto type = eosio::data::types().find_type(suffix.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-table-suffix for unknown struct : ${s}", ("s", suffix));
+            type->suffix_granularity = eosio::data::time_bucket::parse_granularity(suffix.substr(pos + 1));
         }
-        vector<string> ignore_names = {"eosio.", "data."};
-        for (auto name : ignore_names) {
-            pos = dest_name.find(name);
-            if (pos != string::npos)
-                dest_name.replace(pos, name.length(), "");
+    }
+    eosio::data::token_decoder().fast_path = options.at("data-plugin-token-fast-path").as<bool>();
+    eosio::data::token_decoder().verify = options.at("data-plugin-token-verify").as<bool>();
+    auto salt_buckets = options.at("data-plugin-key-salt-buckets").as<uint32_t>();
+    FC_ASSERT(salt_buckets <= 256, "data-plugin-key-salt-buckets should not be more than 256");
+    for (auto type : eosio::data::types().get_all_types())
+        type.second->keys.salt_buckets = salt_buckets;
+    if (options.count("data-plugin-key-format")) {
+        for (auto format : options.at("data-plugin-key-format").as<vector<string> >()) {
+            auto pos = format.rfind('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-key-format should be struct=format : ${f}", ("f", format));
+            auto type = eosio::data::types().find_type(format.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-key-format for unknown struct : ${f}", ("f", format));
+            type->keys.format = eosio::data::key_encoding::parse_format(format.substr(pos + 1));
+        }
+    }
+    if (options.count("data-plugin-payload-format")) {
+        for (auto format : options.at("data-plugin-payload-format").as<vector<string> >()) {
+            auto pos = format.rfind('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-payload-format should be struct=format : ${f}", ("f", format));
+            auto type = eosio::data::types().find_type(format.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-payload-format for unknown struct : ${f}", ("f", format));
+            type->payload_encoding = eosio::data::abstract_type::parse_payload_format(format.substr(pos + 1));
         }
-        std::transform (dest_name.begin(), dest_name.end(), dest_name.begin(), ::tolower);
-        type.second->name = prefix + "." + dest_name;
     }
+    pending_config = load_dispatch(options);
+    switch_config();
+    if (options.at("data-plugin-hot-reload").as<bool>()) {
+        reload_signals = std::make_shared<boost::asio::signal_set>(app().get_io_service(), SIGHUP);
+        startup_options = options;
+        try {
+            startup_file_options = config_file_options();
+        } catch (const std::exception& ex) {
+            wlog ("data-plugin cannot read ${p}, a reload keeps every option set at startup : ${ex}",
+                  ("p", app().full_config_file_path().string())("ex", ex.what()));
+        }
+    }
+    if (options.count("data-plugin-aggregate")) {
+        for (auto aggregate : options.at("data-plugin-aggregate").as<vector<string> >()) {
+            auto pos = aggregate.find('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-aggregate should be struct=spec : ${a}", ("a", aggregate));
+            auto type = eosio::data::types().find_type(aggregate.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-aggregate for unknown struct : ${a}", ("a", aggregate));
+            type->aggregator = std::make_shared<eosio::data::window_aggregator>(aggregate.substr(pos + 1));
+        }
+    }
+
+    fork = fork_buffer(fork_buffer::parse_mode(options.at("data-plugin-fork-mode").as<string>()));
+    //speculative and re-applied transactions would be counted again in the windows
+    FC_ASSERT(!options.count("data-plugin-aggregate") || fork.mode == fork_buffer::irreversible_only,
+              "data-plugin-aggregate needs data-plugin-fork-mode=irreversible-only");
+    if (fork.mode != fork_buffer::all)
+        ilog ("data-plugin fork mode ${m}, reversible records are buffered", ("m", options.at("data-plugin-fork-mode").as<string>()));
+    for (auto type : eosio::data::types().get_all_types())
+        type.second->irreversible_only = fork.mode == fork_buffer::irreversible_only;
+
+    metrics_interval = options.at("data-plugin-metrics-interval").as<uint32_t>();
+    eosio::data::metrics().enabled = metrics_interval > 0;
+    eosio::data::metrics().sample = options.at("data-plugin-metrics-sample").as<uint32_t>();
 
     auto& chain = app().get_plugin<chain_plugin>().chain();
     if (options.at("data-plugin-register-accepted-block").as<bool>()) {
         on_accepted_block_connection = chain.accepted_block.connect([=](const block_state_ptr& block_state) {
-            if (current_block_num < start_block_num) return;
+            if (stopping || !ranges.contains(block_state->block_num)) {
+                switch_config();
+                return;
+            }
+            auto cfg = config;
+            const auto& types = cfg->types;
+            const auto& producers = cfg->producers;
             try{
-                callback(types, producers, block_state, false);
+                if (fork.mode == fork_buffer::all)
+                    callback(types, producers, block_state, false);
+                else
+                    produce_records(producers, fork.accept_block(block_state, build_records(types, block_state, false)));
             } catch (const std::exception& ex) {
                 elog ("std Exception in data_plugin when accept block : ${ex}", ("ex", ex.what()));
             } catch ( fc::exception& ex) {
@@ -97,14 +334,34 @@ void data_plugin::plugin_initialize(const variables_map& options) {
             } catch (...) {
                 elog ("Unknown Exception in data_plugin when accept block");
             }
+            //a reloaded configuration applies from the next block on
+            switch_config();
         });
     }
     if (options.at("data-plugin-register-irreversible-block").as<bool>()) {
         on_irreversible_block_connection = chain.irreversible_block.connect([=](const block_state_ptr& block_state) {
             current_block_num = block_state->block_num;
-            if (current_block_num < start_block_num) return;
+            switch_config();
+            if (stopping) return;
+            if (!ranges.contains(current_block_num)) {
+                if (ranges.past_end(current_block_num)) stop_after_drain();
+                return;
+            }
+            auto cfg = config;
+            const auto& types = cfg->types;
+            const auto& producers = cfg->producers;
             try {
+                if (fork.mode != fork_buffer::all)
+                    produce_records(producers, fork.irreversible_block(block_state));
                 callback(types, producers, block_state, true);
+                flush_aggregators(types, producers, fc::time_point(block_state->header.timestamp));
+                //everything of this block is handed over, the producers confirm it once delivered
+                for (auto pname : producers) {
+                    auto producer = eosio::data::producers().find_producer(pname);
+                    if (producer) producer->mark(current_block_num);
+                }
+                if (checkpoint_interval && current_block_num % checkpoint_interval == 0)
+                    save_checkpoint();
             } catch (const std::exception& ex) {
                 elog ("std Exception in data_plugin when irreversible block : ${ex}", ("ex", ex.what()));
             } catch ( fc::exception& ex) {
@@ -113,18 +370,22 @@ void data_plugin::plugin_initialize(const variables_map& options) {
                 elog ("Unknown Exception in data_plugin when irreversible block");
             }
             ilog ("data_plug, current irreversible block_id : ${current_block_num}", ("current_block_num", current_block_num));
-            if (stop_block_num > start_block_num && current_block_num >= stop_block_num) {
-                ilog ("data plugin stopped. [${from}-${to}]", ("from", start_block_num)("to", stop_block_num));
-                plugin_shutdown();
-                app().quit();
-            }
+            if (ranges.past_end(current_block_num))
+                stop_after_drain();
         });
     }
     if (options.at("data-plugin-register-applied-transaction").as<bool>()) {
         on_applied_transaction_connection = chain.applied_transaction.connect([=](const transaction_trace_ptr& transaction_trace) {
-            if (current_block_num < start_block_num) return;
+            if (stopping || !ranges.contains(transaction_trace->block_num)) return;
+            auto cfg = config;
+            const auto& types = cfg->types;
+            const auto& producers = cfg->producers;
             try {
-                callback(types, producers, transaction_trace);
+                if (fork.mode == fork_buffer::all)
+                    callback(types, producers, transaction_trace);
+                else
+                    fork.add_transaction(transaction_trace->block_num, transaction_trace->id,
+                                         build_records(types, transaction_trace), implicit_transaction(transaction_trace));
             } catch (const std::exception& ex) {
                 elog ("std Exception in data_plugin when applied transaction : ${ex}", ("ex", ex.what()));
             } catch ( fc::exception& ex) {
@@ -136,9 +397,17 @@ void data_plugin::plugin_initialize(const variables_map& options) {
     }
     if (options.at("data-plugin-register-accepted-transaction").as<bool>()) {
         on_accepted_transaction_connection = chain.accepted_transaction.connect([=](const transaction_metadata_ptr& transaction_metadata) {
-            if (current_block_num < start_block_num) return;
+            //not in a block yet, it goes in the one being built on the head
+            if (stopping || !ranges.contains(app().get_plugin<chain_plugin>().chain().head_block_num() + 1)) return;
+            auto cfg = config;
+            const auto& types = cfg->types;
+            const auto& producers = cfg->producers;
             try {
-                callback(types, producers, transaction_metadata);
+                if (fork.mode == fork_buffer::all)
+                    callback(types, producers, transaction_metadata);
+                else
+                    fork.add_unplaced(app().get_plugin<chain_plugin>().chain().head_block_num(), transaction_metadata->id,
+                                      build_records(types, transaction_metadata));
             } catch (const std::exception& ex) {
                 elog ("std Exception in data_plugin when accepted transaction : ${ex}", ("ex", ex.what()));
             } catch ( fc::exception& ex) {
@@ -155,6 +424,42 @@ void data_plugin::plugin_startup() {
     for (auto producer : eosio::data::producers().get_all_producers()) {
         producer.second->startup();
     }
+    if (metrics_interval) {
+        metrics_timer = std::make_shared<boost::asio::deadline_timer>(app().get_io_service());
+        schedule_metrics();
+    }
+    if (reload_signals)
+        schedule_reload();
+    if (ranges.ranges.empty()) {
+        ilog ("data-plugin has no block left to build, the checkpoint is past the last range");
+        stop_after_drain();
+    }
+}
+
+//events are ignored from now on, nodeos quits once the signal being handled returns and
+//plugin_shutdown stops the producers, which deliver what they hold
+void data_plugin::stop_after_drain() {
+    if (stopping) return;
+    stopping = true;
+    ilog ("data plugin stopped at block ${n}, ranges [${r}]", ("n", current_block_num)("r", ranges.to_string()));
+    app().get_io_service().post([]() {
+        app().quit();
+    });
+}
+
+void data_plugin::schedule_metrics() {
+    metrics_timer->expires_from_now(boost::posix_time::seconds(metrics_interval));
+    metrics_timer->async_wait([this](const boost::system::error_code& error) {
+        if (error) return;
+        std::map<string, uint64_t> queue_depths;
+        for (auto pname : config->producers) {
+            auto producer = eosio::data::producers().find_producer(pname);
+            if (producer)
+                queue_depths[pname] = producer->queue_depth();
+        }
+        eosio::data::metrics().report(metrics_interval, queue_depths);
+        schedule_metrics();
+    });
 }
 
 void data_plugin::plugin_shutdown() {
@@ -163,9 +468,164 @@ void data_plugin::plugin_shutdown() {
     on_irreversible_block_connection.disconnect();
     on_applied_transaction_connection.disconnect();
     on_accepted_transaction_connection.disconnect();
+    if (metrics_timer)
+        metrics_timer->cancel();
+    if (reload_signals)
+        reload_signals->cancel();
+    try {
+        flush_aggregators(config->types, config->producers, fc::optional<fc::time_point>());
+    } catch (const fc::exception& ex) {
+        elog ("data-plugin flush aggregated windows failed : ${ex}", ("ex", ex.to_detail_string()));
+    }
+    for (auto type : eosio::data::types().get_all_types()) {
+        if (type.second->projection)
+            type.second->projection->report(type.second->name);
+        if (type.second->limit)
+            type.second->limit->report(type.second->name);
+    }
     for (auto producer : eosio::data::producers().get_all_producers()) {
         producer.second->stop();
     }
+    if (checkpoint_interval)
+        save_checkpoint();
+}
+
+std::shared_ptr<const data_plugin::dispatch_config> data_plugin::load_dispatch(const variables_map& options) {
+    auto cfg = std::make_shared<dispatch_config>();
+    cfg->types = options.at("data-plugin-struct").as<vector<string> >();
+    for (auto type : cfg->types) {
+        if (!eosio::data::types().find_type(type)) 
+            wlog ("data-plugin initialize warnning : type ${type} not found", ("type", type));
+    }
+    cfg->producers = options.at("data-plugin-producer").as<vector<string> >();
+    for (auto producer : cfg->producers) {
+        if (!eosio::data::producers().find_producer(producer))
+            wlog ("data-plugin initialize warnning : producer ${producer} not found",
+                    ("producer", producer));
+    }
+    if (options.count("data-plugin-fields")) {
+        auto sample = options.at("data-plugin-fields-sample").as<uint32_t>();
+        for (auto fields : options.at("data-plugin-fields").as<vector<string> >()) {
+            auto pos = fields.find('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-fields should be struct=include:paths or struct=exclude:paths : ${f}", ("f", fields));
+            auto type = eosio::data::types().find_type(fields.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-fields for unknown struct : ${f}", ("f", fields));
+            FC_ASSERT(!type->whole_object() || type->payload_encoding == eosio::data::abstract_type::payload_json,
+                      "data-plugin-fields cannot select inside a binary payload, it packs the whole chain object : ${f}", ("f", fields));
+            auto projection = std::make_shared<eosio::data::field_projection>(fields.substr(pos + 1));
+            projection->sample = sample;
+            cfg->projections[type->name] = projection;
+        }
+    }
+    if (options.count("data-plugin-limit")) {
+        for (auto limit : options.at("data-plugin-limit").as<vector<string> >()) {
+            auto pos = limit.find('=');
+            FC_ASSERT(pos != string::npos, "data-plugin-limit should be struct=spec : ${l}", ("l", limit));
+            auto type = eosio::data::types().find_type(limit.substr(0, pos));
+            FC_ASSERT(type, "data-plugin-limit for unknown struct : ${l}", ("l", limit));
+            cfg->limits[type->name] = std::make_shared<eosio::data::emission_limit>(limit.substr(pos + 1));
+        }
+    }
+    return cfg;
+}
+
+variables_map data_plugin::config_file_options() {
+    options_description cli, cfg;
+    set_program_options(cli, cfg);
+    variables_map options;
+    bpo::store(bpo::parse_config_file<char>(app().full_config_file_path().string().c_str(), cfg, true), options);
+    bpo::notify(options);
+    return options;
+}
+
+//the options a reload reads again. config.ini gives them, except what the command line set at startup :
+//its values of a list are kept in front of the ones of config.ini, its value of a single option wins
+variables_map data_plugin::merge_reloaded(const variables_map& file_options) {
+    static const vector<string> list_options = {"data-plugin-struct", "data-plugin-producer", "data-plugin-limit", "data-plugin-fields"};
+    variables_map options = file_options;
+    for (auto& key : list_options) {
+        if (!startup_options.count(key)) continue;
+        vector<string> from_file = startup_file_options.count(key) ? startup_file_options.at(key).as<vector<string> >() : vector<string>();
+        vector<string> from_cli;
+        for (auto& value : startup_options.at(key).as<vector<string> >())
+            if (std::find(from_file.begin(), from_file.end(), value) == from_file.end())
+                from_cli.push_back(value);
+        if (from_cli.empty()) continue;
+        ilog ("data-plugin reload : ${key} keeps ${values} from the command line", ("key", key)("values", from_cli));
+        if (options.count(key))
+            for (auto& value : options.at(key).as<vector<string> >())
+                if (std::find(from_cli.begin(), from_cli.end(), value) == from_cli.end())
+                    from_cli.push_back(value);
+        options.erase(key);
+        options.insert(std::make_pair(key, bpo::variable_value(from_cli, false)));
+    }
+    const string sample = "data-plugin-fields-sample";
+    auto& started = startup_options.at(sample);
+    if (!started.defaulted() && (!startup_file_options.count(sample)
+            || startup_file_options.at(sample).as<uint32_t>() != started.as<uint32_t>())) {
+        ilog ("data-plugin reload : ${key} keeps ${value} from the command line", ("key", sample)("value", started.as<uint32_t>()));
+        options.erase(sample);
+        options.insert(std::make_pair(sample, started));
+    }
+    return options;
+}
+
+//only the dispatch options are read again, the producers keep the connections they started with
+void data_plugin::reload() {
+    try {
+        auto options = merge_reloaded(config_file_options());
+        pending_config = load_dispatch(options);
+        ilog ("data-plugin configuration reloaded from ${p}, applied from the next block", ("p", app().full_config_file_path().string()));
+    } catch (const fc::exception& ex) {
+        elog ("data-plugin reload failed, the configuration is kept : ${ex}", ("ex", ex.to_detail_string()));
+    } catch (const std::exception& ex) {
+        elog ("data-plugin reload failed, the configuration is kept : ${ex}", ("ex", ex.what()));
+    }
+}
+
+void data_plugin::schedule_reload() {
+    reload_signals->async_wait([this](const boost::system::error_code& error, int) {
+        if (error) return;
+        reload();
+        schedule_reload();
+    });
+}
+
+void data_plugin::switch_config() {
+    if (!pending_config) return;
+    auto previous = config;
+    config = pending_config;
+    pending_config.reset();
+    for (auto type : eosio::data::types().get_all_types()) {
+        auto projection = config->projections.find(type.second->name);
+        type.second->projection = projection == config->projections.end() ? nullptr : projection->second;
+        auto limit = config->limits.find(type.second->name);
+        type.second->limit = limit == config->limits.end() ? nullptr : limit->second;
+    }
+    if (!previous) return;
+    //the open windows of the structs no longer built go out now
+    vector<string> removed;
+    for (auto& type : previous->types)
+        if (std::find(config->types.begin(), config->types.end(), type) == config->types.end())
+            removed.push_back(type);
+    flush_aggregators(removed, previous->producers, fc::optional<fc::time_point>());
+    ilog ("data-plugin switched to structs ${t} and producers ${p}", ("t", config->types)("p", config->producers));
+}
+
+void data_plugin::save_checkpoint() {
+    bool changed = false;
+    for (auto pname : config->producers) {
+        auto producer = eosio::data::producers().find_producer(pname);
+        if (!producer) continue;
+        auto confirmed = producer->confirmed();
+        auto& saved = checkpoint_positions[pname];
+        if (confirmed > saved) {
+            saved = confirmed;
+            changed = true;
+        }
+    }
+    if (changed)
+        checkpoint.save(checkpoint_positions);
 }
 
 }
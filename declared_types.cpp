@@ -0,0 +1,353 @@
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fc/io/json.hpp>
+#include <fc/filesystem.hpp>
+#include <eosio/chain/asset.hpp>
+#include <boost/algorithm/string.hpp>
+#include <eosio/data_plugin/types.hpp>
+
+namespace eosio{ namespace data{ namespace declared{
+
+using std::string;
+using std::vector;
+using namespace chain;
+using key_values = abstract_type::key_values;
+
+/**
+ * a struct defined in a struct file instead of c++, see load_declared_types.
+ *
+ * the definition is compiled once : names into their uint64 values, paths into their
+ * segments, the key template into literals and field indexes. action structs run on the
+ * trace flattened once per event and match their filters on the native action traces.
+ */
+struct declared_type : abstract_type {
+    enum event_kind { event_action, event_transaction, event_block };
+
+    struct filter {
+        uint64_t account = 0;   //0 matches any
+        uint64_t action = 0;
+        uint64_t receiver = 0;
+        bool receiver_is_account = false;
+    };
+
+    struct field {
+        enum source_kind { path, block_num, block_time, block_id, trx_id, table_suffix };
+        enum transform_kind { none, amount, symbol, json, text };
+        string output;
+        source_kind source = path;
+        vector<string> segments;
+        transform_kind transform = none;
+        //act.data.<from|to|quantity|memo> of a token transfer, read from the raw data when possible
+        string token_field;
+    };
+
+    struct key_part {
+        string literal;
+        int field = -1;         //index into fields, the literal otherwise
+    };
+
+    enum key_kind { key_action, key_transaction, key_block, key_template };
+
+    explicit declared_type(const fc::variant_object& def) {
+        auto kind = def.contains("event") ? def["event"].as_string() : string("action");
+        if (kind == "action")           event = event_action;
+        else if (kind == "transaction") event = event_transaction;
+        else if (kind == "block")       event = event_block;
+        else FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown struct event ${e}, expect action/transaction/block", ("e", kind));
+
+        if (def.contains("filters")) {
+            for (auto& f : def["filters"].get_array()) {
+                auto& fobj = f.get_object();
+                filter compiled;
+                if (fobj.contains("account"))  compiled.account = name(fobj["account"].as_string()).value;
+                if (fobj.contains("action"))   compiled.action = name(fobj["action"].as_string()).value;
+                if (fobj.contains("receiver")) {
+                    auto receiver = fobj["receiver"].as_string();
+                    if (receiver == "@account") compiled.receiver_is_account = true;
+                    else compiled.receiver = name(receiver).value;
+                }
+                filters.push_back(compiled);
+            }
+        }
+        if (def.contains("irreversible"))
+            irreversible = def["irreversible"].as_bool();
+
+        FC_ASSERT(def.contains("fields") && def["fields"].is_object(), "struct definition without fields");
+        for (auto& f : def["fields"].get_object())
+            fields.push_back(compile_field(f.key(), f.value().as_string()));
+
+        auto key = def.contains("key") ? def["key"].as_string() : default_key();
+        if (key == "action")           key_type = key_action;
+        else if (key == "transaction") key_type = key_transaction;
+        else if (key == "block")       key_type = key_block;
+        else {
+            key_type = key_template;
+            compile_key(key);
+        }
+        FC_ASSERT(key_type != key_action || event == event_action, "an action key needs an action struct");
+        FC_ASSERT(key_type != key_transaction || event != event_block, "a transaction key needs an action or transaction struct");
+        FC_ASSERT(key_type != key_block || event == event_block, "a block key needs a block struct");
+
+        if (def.contains("primary_key"))
+            primary_key = def["primary_key"].as_bool();
+        if (def.contains("table_suffix"))
+            suffix_granularity = time_bucket::parse_granularity(def["table_suffix"].as_string());
+    }
+
+    key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
+        key_values res;
+        if (event == event_block) return res;
+        const auto& flat = flatten(ttp, obj);
+        context ctx{ttp->block_num, ttp->block_time, block_id_type(), ttp->id, &table_suffix(ttp->block_time)};
+        if (event == event_transaction) {
+            bool matched = filters.empty();
+            for (size_t i = 0; !matched && i < flat.actions.size(); i ++)
+                matched = match(flat.actions[i].get_object(), flat.native(i));
+            if (matched)
+                emit(fc::variant_object(obj), ctx, nullptr, res);
+            return res;
+        }
+        for (size_t i = 0; i < flat.actions.size(); i ++) {
+            auto& trace = flat.actions[i].get_object();
+            if (match(trace, flat.native(i)))
+                emit(trace, ctx, flat.native(i), res);
+        }
+        return res;
+    }
+
+    key_values build(const block_state_ptr& bsp, const fc::mutable_variant_object& obj) {
+        key_values res;
+        if (event != event_block) return res;
+        if (irreversible) {
+            auto it = obj.find("irreversible");
+            if (it == obj.end() || it->value().as_bool() != *irreversible) return res;
+        }
+        context ctx{bsp->block_num, bsp->header.timestamp, bsp->id, transaction_id_type(), &table_suffix(bsp->header.timestamp)};
+        emit(fc::variant_object(obj), ctx, nullptr, res);
+        return res;
+    }
+
+private:
+    struct context {
+        uint32_t block_num;
+        block_timestamp_type block_time;
+        block_id_type block_id;
+        transaction_id_type trx_id;
+        const string* suffix;
+    };
+
+    string default_key() const {
+        if (event == event_action) return "action";
+        if (event == event_transaction) return "transaction";
+        return "block";
+    }
+
+    static field compile_field(const string& output, const string& spec) {
+        field f;
+        f.output = output;
+        auto source = spec;
+        auto pos = spec.rfind(':');
+        if (pos != string::npos) {
+            source = spec.substr(0, pos);
+            auto transform = spec.substr(pos + 1);
+            if (transform == "amount")      f.transform = field::amount;
+            else if (transform == "symbol") f.transform = field::symbol;
+            else if (transform == "json")   f.transform = field::json;
+            else if (transform == "string") f.transform = field::text;
+            else FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown field transform ${t}, expect amount/symbol/json/string", ("t", transform));
+        }
+        if (source == "@block_num")         f.source = field::block_num;
+        else if (source == "@block_time")   f.source = field::block_time;
+        else if (source == "@block_id")     f.source = field::block_id;
+        else if (source == "@trx_id")       f.source = field::trx_id;
+        else if (source == "@table_suffix") f.source = field::table_suffix;
+        else {
+            FC_ASSERT(!source.empty() && source[0] != '@', "unknown field source ${s}", ("s", source));
+            boost::split(f.segments, source, boost::is_any_of("."));
+            if (f.segments.size() == 3 && f.segments[0] == "act" && f.segments[1] == "data") {
+                auto& n = f.segments[2];
+                if (n == "from" || n == "to" || n == "quantity" || n == "memo")
+                    f.token_field = n;
+            }
+        }
+        return f;
+    }
+
+    //"{transaction_id}-{from}", the names between braces are output fields
+    void compile_key(const string& key) {
+        size_t pos = 0;
+        while (pos < key.size()) {
+            auto open = key.find('{', pos);
+            if (open == string::npos) {
+                key_parts.push_back({key.substr(pos), -1});
+                break;
+            }
+            if (open > pos)
+                key_parts.push_back({key.substr(pos, open - pos), -1});
+            auto close = key.find('}', open);
+            FC_ASSERT(close != string::npos, "unclosed { in key ${k}", ("k", key));
+            auto output = key.substr(open + 1, close - open - 1);
+            int index = -1;
+            for (size_t i = 0; i < fields.size(); i ++)
+                if (fields[i].output == output) index = int(i);
+            FC_ASSERT(index >= 0, "key ${k} uses ${f} which is not a field", ("k", key)("f", output));
+            key_parts.push_back({string(), index});
+            pos = close + 1;
+        }
+    }
+
+    bool match(const fc::variant_object& trace, const action_trace* native) const {
+        if (filters.empty()) return true;
+        uint64_t account, action, receiver;
+        if (native) {
+            account = native->act.account.value;
+            action = native->act.name.value;
+            receiver = native->receipt.receiver.value;
+        } else {
+            auto& act = trace["act"].get_object();
+            account = act["account"].as<name>().value;
+            action = act["name"].as<name>().value;
+            receiver = trace["receipt"].get_object()["receiver"].as<name>().value;
+        }
+        for (auto& f : filters) {
+            if (f.account && f.account != account) continue;
+            if (f.action && f.action != action) continue;
+            if (f.receiver && f.receiver != receiver) continue;
+            if (f.receiver_is_account && receiver != account) continue;
+            return true;
+        }
+        return false;
+    }
+
+    static const fc::variant* lookup(const fc::variant_object& root, const vector<string>& segments) {
+        auto it = root.find(segments[0]);
+        if (it == root.end()) return nullptr;
+        const fc::variant* v = &it->value();
+        for (size_t i = 1; i < segments.size(); i ++) {
+            if (v->is_object()) {
+                auto& o = v->get_object();
+                auto next = o.find(segments[i]);
+                if (next == o.end()) return nullptr;
+                v = &next->value();
+            } else if (v->is_array()) {
+                auto& a = v->get_array();
+                auto index = std::strtoul(segments[i].c_str(), nullptr, 10);
+                if (index >= a.size()) return nullptr;
+                v = &a[index];
+            } else {
+                return nullptr;
+            }
+        }
+        return v;
+    }
+
+    static fc::variant apply(const field& f, const fc::variant& value) {
+        switch (f.transform) {
+        case field::amount:
+            return value.as<asset>().to_real();
+        case field::symbol:
+            return value.as<asset>().symbol_name();
+        case field::json:
+            return fc::json::to_string(value, fc::json::legacy_generator);
+        case field::text:
+            return value.is_string() ? value : fc::variant(fc::json::to_string(value, fc::json::legacy_generator));
+        default:
+            return value;
+        }
+    }
+
+    static fc::variant token_value(const field& f, const token_transfer& transfer) {
+        if (f.token_field == "from") return apply(f, fc::variant(transfer.from));
+        if (f.token_field == "to")   return apply(f, fc::variant(transfer.to));
+        if (f.token_field == "memo") return apply(f, fc::variant(transfer.memo));
+        if (f.transform == field::amount) return transfer.quantity.to_real();
+        if (f.transform == field::symbol) return transfer.quantity.symbol_name();
+        return apply(f, fc::variant(transfer.quantity));
+    }
+
+    void emit(const fc::variant_object& root, const context& ctx, const action_trace* native, key_values& res) const {
+        fc::mutable_variant_object resobj;
+        vector<const fc::variant*> values(fields.size(), nullptr);
+        vector<fc::variant> computed(fields.size());
+        //decoded at the first token field of the action
+        int token_state = 0;
+        token_transfer transfer;
+        for (size_t i = 0; i < fields.size(); i ++) {
+            auto& f = fields[i];
+            switch (f.source) {
+            case field::block_num:    computed[i] = ctx.block_num; break;
+            case field::block_time:   computed[i] = ctx.block_time; break;
+            case field::block_id:     computed[i] = ctx.block_id; break;
+            case field::trx_id:       computed[i] = ctx.trx_id; break;
+            case field::table_suffix: computed[i] = *ctx.suffix; break;
+            case field::path: {
+                if (!f.token_field.empty() && token_state == 0) {
+                    auto act = root.find("act");
+                    auto data = act == root.end() ? fc::variant() : act->value().get_object()["data"];
+                    token_state = decode_token_transfer(native, data, transfer) ? 1 : -1;
+                }
+                if (!f.token_field.empty() && token_state == 1) {
+                    computed[i] = token_value(f, transfer);
+                    break;
+                }
+                auto v = lookup(root, f.segments);
+                if (!v) continue;
+                if (f.transform == field::none) {
+                    values[i] = v;
+                    resobj(f.output, *v);
+                    continue;
+                }
+                computed[i] = apply(f, *v);
+                break;
+            }
+            }
+            values[i] = &computed[i];
+            resobj(f.output, computed[i]);
+        }
+        string key;
+        switch (key_type) {
+        case key_action:      key = action_key(root); break;
+        case key_transaction: key = keys.transaction(ctx.block_num, ctx.trx_id); break;
+        case key_block:       key = string(ctx.block_id); break;
+        case key_template:
+            for (auto& part : key_parts) {
+                if (part.field < 0) key += part.literal;
+                else if (values[part.field])
+                    key += values[part.field]->is_string() ? values[part.field]->get_string() : fc::json::to_string(*values[part.field]);
+            }
+            break;
+        }
+        if (primary_key)
+            resobj.set("primary_key", keys.printable(key));
+        res.push_back({key, resobj});
+    }
+
+    event_kind event = event_action;
+    vector<filter> filters;
+    fc::optional<bool> irreversible;
+    vector<field> fields;
+    key_kind key_type = key_action;
+    vector<key_part> key_parts;
+    bool primary_key = false;
+};
+
+}
+
+void load_declared_types(const fc::path& file) {
+    FC_ASSERT(fc::exists(file), "struct file ${f} does not exist", ("f", file));
+    auto def = fc::json::from_file(file);
+    FC_ASSERT(def.is_object() && def.get_object().contains("structs"), "struct file ${f} should be {\"structs\": [...]}", ("f", file));
+    for (auto& s : def["structs"].get_array()) {
+        auto& sobj = s.get_object();
+        FC_ASSERT(sobj.contains("name"), "struct without name in ${f}", ("f", file));
+        auto type_name = sobj["name"].as_string();
+        FC_ASSERT(!types().find_type(type_name), "struct ${n} of ${f} is already defined", ("n", type_name)("f", file));
+        try {
+            types().register_type(type_name, std::make_shared<declared::declared_type>(sobj));
+        } FC_CAPTURE_AND_RETHROW((type_name)(file))
+        ilog ("data-plugin struct ${n} loaded from ${f}", ("n", type_name)("f", file));
+    }
+}
+
+}} //eosio::data
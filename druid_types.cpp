@@ -1,4 +1,3 @@
-#include <queue>
 #include <string>
 #include <vector>
 #include <chrono>
@@ -7,10 +6,10 @@
 #include <boost/lexical_cast.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/data_plugin/types.hpp>
+#include <eosio/data_plugin/name_set.hpp>
 
 namespace eosio{ namespace data{ namespace druid{
 
-using std::queue;
 using std::string;
 using std::vector;
 using namespace chain;
@@ -19,32 +18,10 @@ using key_values = abstract_type::key_values;
 struct Transfer : type<Transfer> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         key_values res;
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             auto resobj = fc::mutable_variant_object
                 ("transaction_id", trace["trx_id"])
                 ("block_num", ttp->block_num)
@@ -53,14 +30,21 @@ struct Transfer : type<Transfer> {
             string account = string(trace["act"].get_object()["account"].as<account_name>());
             string name = string(trace["act"].get_object()["name"].as<account_name>());
             if (account == "eosio.token" && name == "transfer") {
-                auto data = trace["act"].get_object()["data"].get_object();
-                resobj.set("from", data["from"]);
-                resobj.set("to", data["to"]);
-                resobj.set("memo", data["memo"]);
-                auto quantity = data["quantity"].as<asset>();
-                resobj.set("symbol", quantity.symbol_name());
-                resobj.set("amount", quantity.to_real());
-                string key = build_action_key(trace);
+                const auto& data = trace["act"].get_object()["data"];
+                token_transfer transfer;
+                if (decode_token_transfer(flat.native(i), data, transfer)) {
+                    resobj.set("from", string(transfer.from));
+                    resobj.set("to", string(transfer.to));
+                    resobj.set("memo", transfer.memo);
+                } else {
+                    resobj.set("from", data["from"]);
+                    resobj.set("to", data["to"]);
+                    resobj.set("memo", data["memo"]);
+                    transfer.quantity = data["quantity"].as<asset>();
+                }
+                resobj.set("symbol", transfer.quantity.symbol_name());
+                resobj.set("amount", transfer.quantity.to_real());
+                string key = action_key(trace);
                 res.push_back({key, resobj});
             }
         }
@@ -72,31 +56,30 @@ static auto _transfer = types().register_type<Transfer>();
 struct Resource : type<Transfer> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         key_values res; 
-        std::vector<string> actors;
-        string receiver = "";
         if (ttp->receipt) {
+            static thread_local name_tuple_set<1> actors;
+            actors.clear();
+            name receiver;
             auto receipt_header = *(ttp->receipt);
-            for (auto trace : ttp->action_traces) {
-                for (auto auth : trace.act.authorization) {
-                    auto actor = auth.actor;
-                    if (std::find(actors.begin(), actors.end(), string(actor)) == actors.end()) {
-                        actors.push_back(string(actor));
-                    }
-                }
-                if (receiver == "") {
-                    receiver = string(trace.receipt.receiver);
-                }
+            for (const auto& trace : ttp->action_traces) {
+                for (const auto& auth : trace.act.authorization)
+                    actors.insert({{auth.actor.value}});
+                if (receiver.value == 0)
+                    receiver = trace.receipt.receiver;
             }
-            for (auto actor : actors) {
+            string trx_id = ttp->id;
+            string receiver_str = receiver.to_string();
+            for (const auto& actor : actors.items) {
+                string actor_str = name(actor[0]).to_string();
                 auto resobj = fc::mutable_variant_object
                     ("block_time", ttp->block_time)
                     ("trx", ttp->id)
                     ("cpu_usage_us", static_cast<uint32_t>(receipt_header.cpu_usage_us))
                     ("net_usage_words", static_cast<uint32_t>(receipt_header.net_usage_words))
-                    ("actor", actor)
-                    ("receiver",receiver)
+                    ("actor", actor_str)
+                    ("receiver",receiver_str)
                 ;
-                string key = string(ttp->id) + "|" + string(actor);
+                string key = trx_id + "|" + actor_str;
                 res.push_back({key, resobj});
             }
         }
@@ -108,27 +91,19 @@ static auto _resource = types().register_type<Resource>();
 struct Active : type<Active> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         key_values res; 
-        std::vector<string> actor_receivers;
         if (ttp->receipt) {
-            auto receipt_header = *(ttp->receipt);
-            for (auto trace : ttp->action_traces) {
-                auto receiver = trace.receipt.receiver;
-                auto action = trace.act.account;
-                auto name = trace.act.name;
-                for (auto auth : trace.act.authorization) {
-                    auto actor = auth.actor;
-                    string actor_receiver = string(actor) + ":" + string(receiver) + ":" + string(action) + "_" + string(name);
-                    if (std::find(actor_receivers.begin(), actor_receivers.end(), actor_receiver) == actor_receivers.end()) {
-                        actor_receivers.push_back(actor_receiver);
-                    }
-                }
+            //actor, receiver, contract, action
+            static thread_local name_tuple_set<4> actor_receivers;
+            actor_receivers.clear();
+            for (const auto& trace : ttp->action_traces) {
+                for (const auto& auth : trace.act.authorization)
+                    actor_receivers.insert({{auth.actor.value, trace.receipt.receiver.value, trace.act.account.value, trace.act.name.value}});
             }
-            for (auto actor_receiver : actor_receivers) {
-                size_t first_pos = actor_receiver.find(":");
-                string actor = actor_receiver.substr(0, first_pos);
-                size_t secon_pos = actor_receiver.find(":", first_pos+1);
-                string receiver = actor_receiver.substr(first_pos+1, secon_pos-first_pos-1);
-                string action_name = actor_receiver.substr(secon_pos+1);
+            string trx_id = ttp->id;
+            for (const auto& t : actor_receivers.items) {
+                string actor = name(t[0]).to_string();
+                string receiver = name(t[1]).to_string();
+                string action_name = name(t[2]).to_string() + "_" + name(t[3]).to_string();
                 auto resobj = fc::mutable_variant_object
                     ("block_time", ttp->block_time)
                     ("trx", ttp->id)
@@ -136,7 +111,7 @@ struct Active : type<Active> {
                     ("receiver",receiver)
                     ("method", action_name)
                 ;
-                string key = string(ttp->id) + "|" + string(actor_receiver);
+                string key = trx_id + "|" + actor + ":" + receiver + ":" + action_name;
                 res.push_back({key, resobj});
             }
         }
@@ -1,4 +1,3 @@
-#include <queue>
 #include <string>
 #include <vector>
 #include <chrono>
@@ -11,7 +10,6 @@
 
 namespace eosio{ namespace data{ namespace es{
 
-using std::queue;
 using std::string;
 using std::vector;
 using namespace chain;
@@ -27,7 +25,10 @@ struct BlockInfo : type<BlockInfo> {
     key_values build(const block_state_ptr& bsp, const fc::mutable_variant_object& obj) {
         key_values res;
         fc::mutable_variant_object resobj;
-        if (!obj["irreversible"].as<bool>()) {
+        bool irreversible = obj["irreversible"].as<bool>();
+        //the accepted record would go out together with the irreversible one, the latter carries it all
+        if (!irreversible && irreversible_only) return res;
+        if (!irreversible || irreversible_only) {
             resobj = fc::mutable_variant_object
                 ("primary_key", string(obj["block_num"].as<block_id_type>()))
                 ("block_id_askey", obj["id"])
@@ -45,25 +46,14 @@ struct BlockInfo : type<BlockInfo> {
                     trxids.push_back(trx.trx.get<packed_transaction>().id());
             }
             resobj.set("trxs_num", static_cast<uint32_t>(trxids.size()));
+            if (irreversible) resobj.set("irreversible", true);
         } else {
             resobj = fc::mutable_variant_object
                 ("primary_key", string(obj["block_num"].as<block_id_type>()))
                 ("irreversible", obj["irreversible"].as<bool>())
             ;
         }
-        string block_time = obj["header"].get_object()["timestamp"].as<string>();
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        if (pos != string::npos && pos > 2) {
-            if (block_time.length() > pos - 2) {
-                block_time = block_time.substr(0, pos - 2);
-                resobj.set("table_suffix", block_time);
-            }
-        }
+        resobj.set("table_suffix", table_suffix(bsp->header.timestamp));
         string key = string(obj["id"].as<block_id_type>()); 
         key += obj["irreversible"].as<bool>() ? 'T' : 'F';
         res.push_back({key, resobj});
@@ -91,19 +81,7 @@ struct Transaction : type<Transaction> {
                 resobj.set("first_actor" , string(ttp->action_traces[0].act.authorization[0].actor));
             }
         }
-        string block_time = obj["block_time"].as<string>();
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        if (pos != string::npos && pos > 2) {
-            if (block_time.length() > pos - 2) {
-                block_time = block_time.substr(0, pos - 2);
-                resobj.set("table_suffix", block_time);
-            }
-        }
+        resobj.set("table_suffix", table_suffix(ttp->block_time));
         string key = resobj["primary_key"].as<string>();
         key += "FB";
         res.push_back({key, resobj});
@@ -115,46 +93,16 @@ static auto _transaction = types().register_type<Transaction>();
 struct Action : type<Action> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         key_values res;
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
         //基本信息
-        auto block_time = obj["block_time"].as<string>();
         auto block_num  = ttp->block_num;
         auto trx_id = string(ttp->id);
         //计算分表策略
-        fc::optional<string> table_suffix;
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        table_suffix = block_time.substr(0, pos - 2);
+        string table_suffix = this->table_suffix(ttp->block_time);
 
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             auto resobj = fc::mutable_variant_object
                 ("transaction_id", trace["trx_id"])
                 ("block_time", ttp->block_time)
@@ -163,17 +111,19 @@ struct Action : type<Action> {
                 ("account_askey", trace["act"].get_object()["account"])
                 ("name_askey", trace["act"].get_object()["name"])
                 ("receiver_askey", trace["receipt"].get_object()["receiver"])
-                ("authorization", fc::json::to_string(trace["act"].get_object()["authorization"], fc::json::legacy_generator))
-                ("data", fc::json::to_string(trace["act"].get_object()["data"]))
             ;
+            if (wants("authorization"))
+                resobj.set("authorization", fc::json::to_string(trace["act"].get_object()["authorization"], fc::json::legacy_generator));
+            if (wants("data"))
+                resobj.set("data", fc::json::to_string(trace["act"].get_object()["data"]));
             if (trace["act"].get_object()["authorization"].is_array()) {
                 auto authorization = trace["act"].get_object()["authorization"].get_array();
                 if (!authorization.empty()) {
                     resobj.set("first_actor", authorization[0].get_object()["actor"]);
                 }
             }
-            string key = build_action_key(trace);
-            resobj.set("primary_key", key);
+            string key = action_key(trace);
+            resobj.set("primary_key", keys.printable(key));
             res.push_back({key, resobj});
         }
         return res;
@@ -184,49 +134,19 @@ static auto _action = types().register_type<Action>();
 struct BosBank : type<BosBank> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         //从transaction中获取所有的action_trace
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
         //基本信息
-        auto block_time = obj["block_time"].as<string>();
         auto block_num  = ttp->block_num;
         auto trx_id = string(ttp->id);
         //计算分表策略
-        fc::optional<string> table_suffix;
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        table_suffix = block_time.substr(0, pos - 2);
+        string table_suffix = this->table_suffix(ttp->block_time);
         //遍历action_trace筛选符合条件的action_trace
         key_values res;
         vector<string> accounts = {"btc.bos", "eth.bos", "usdt.bos"};
         vector<string> names = {"deposit", "withdraw", "transfer"};
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             string account = string(trace["act"].get_object()["account"].as<account_name>());
             string name = string(trace["act"].get_object()["name"].as<account_name>());
             string receiver = string(trace["receipt"].get_object()["receiver"].as<account_name>());
@@ -235,23 +155,31 @@ struct BosBank : type<BosBank> {
                 fc::optional<string> from, to, memo;
                 fc::optional<asset>  quantity;
                 fc::optional<string> inoutrecords; //兼容处理,由于deposit的to和withdraw的from表示同样的意义,这里把他们统一放在一个列里
-                if (data.find("from") != data.end()) {
-                    from = data["from"].as<string>();
-                    if (name == "withdraw") {
-                        inoutrecords = data["from"].as<string>();
+                token_transfer transfer;
+                if (decode_token_transfer(flat.native(i), data, transfer)) {
+                    from = string(transfer.from);
+                    to = string(transfer.to);
+                    memo = transfer.memo;
+                    quantity = transfer.quantity;
+                } else {
+                    if (data.find("from") != data.end()) {
+                        from = data["from"].as<string>();
+                        if (name == "withdraw") {
+                            inoutrecords = data["from"].as<string>();
+                        }
                     }
-                }
-                if (data.find("to") != data.end()) {
-                    to = data["to"].as<string>();
-                    if (name == "deposit") {
-                        inoutrecords = data["to"].as<string>();
+                    if (data.find("to") != data.end()) {
+                        to = data["to"].as<string>();
+                        if (name == "deposit") {
+                            inoutrecords = data["to"].as<string>();
+                        }
+                    }
+                    if (data.find("memo") != data.end()) {
+                        memo = data["memo"].as<string>();
+                    }
+                    if (data.find("quantity") != data.end()) {
+                        quantity = data["quantity"].as<asset>();
                     }
-                }
-                if (data.find("memo") != data.end()) {
-                    memo = data["memo"].as<string>();
-                }
-                if (data.find("quantity") != data.end()) {
-                    quantity = data["quantity"].as<asset>();
                 }
                 auto resobj= fc::mutable_variant_object
                     ("transaction_id", trx_id)
@@ -260,8 +188,9 @@ struct BosBank : type<BosBank> {
                     ("table_suffix", table_suffix)
                     ("account", account)
                     ("name", name)
-                    ("data", fc::json::to_string(data, fc::json::legacy_generator))
                 ;
+                if (wants("data"))
+                    resobj.set("data", fc::json::to_string(data, fc::json::legacy_generator));
                 if (from) {
                     resobj.set("from", from);
                 }
@@ -278,8 +207,8 @@ struct BosBank : type<BosBank> {
                 if (inoutrecords) {
                     resobj.set("inoutrecords", inoutrecords);
                 }
-                string key = build_action_key(trace);
-                resobj.set("primary_key", key);
+                string key = action_key(trace);
+                resobj.set("primary_key", keys.printable(key));
                 res.push_back({key, resobj});
             }
         }
@@ -291,47 +220,17 @@ static auto _bosbank = types().register_type<BosBank>();
 struct Uid : type<Uid> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         //从transaction中获取所有的action_trace
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
         //基本信息
-        auto block_time = obj["block_time"].as<string>();
         auto block_num  = ttp->block_num;
         auto trx_id = string(ttp->id);
         //计算分表策略
-        fc::optional<string> table_suffix;
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        table_suffix = block_time.substr(0, pos - 2);
+        string table_suffix = this->table_suffix(ttp->block_time);
         //遍历action_trace筛选符合条件的action_trace
         key_values res;
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             string account = string(trace["act"].get_object()["account"].as<account_name>());
             string name = string(trace["act"].get_object()["name"].as<account_name>());
             string receiver = string(trace["receipt"].get_object()["receiver"].as<account_name>());
@@ -358,8 +257,9 @@ struct Uid : type<Uid> {
                     ("table_suffix", table_suffix)
                     ("account", account)
                     ("name", name)
-                    ("data", fc::json::to_string(data, fc::json::legacy_generator))
                 ;
+                if (wants("data"))
+                    resobj.set("data", fc::json::to_string(data, fc::json::legacy_generator));
                 if (username) {
                     resobj.set("from", username);
                 }
@@ -373,8 +273,8 @@ struct Uid : type<Uid> {
                 if (memo) {
                     resobj.set("memo", memo);
                 }
-                string key = build_action_key(trace);
-                resobj.set("primary_key", key);
+                string key = action_key(trace);
+                resobj.set("primary_key", keys.printable(key));
                 res.push_back({key, resobj});
             }
         }
@@ -386,47 +286,17 @@ static auto _uid = types().register_type<Uid>();
 struct Transfer : type<Transfer> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         //从transaction中获取所有的action_trace
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
         //基本信息
-        auto block_time = obj["block_time"].as<string>();
         auto block_num  = ttp->block_num;
         auto trx_id = string(ttp->id);
         //计算分表策略
-        fc::optional<string> table_suffix;
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        table_suffix = block_time.substr(0, pos - 2);
+        string table_suffix = this->table_suffix(ttp->block_time);
         //遍历action_trace筛选符合条件的action_trace
         key_values res;
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             string account = string(trace["act"].get_object()["account"].as<account_name>());
             string name = string(trace["act"].get_object()["name"].as<account_name>());
             string receiver = string(trace["receipt"].get_object()["receiver"].as<account_name>());
@@ -434,17 +304,25 @@ struct Transfer : type<Transfer> {
                 auto data = trace["act"].get_object()["data"].get_object();
                 fc::optional<string> from, to, memo;
                 fc::optional<asset> quantity;
-                if (data.find("from") != data.end()) {
-                    from = data["from"].as<string>();
-                }
-                if (data.find("to") != data.end()) {
-                    to = data["to"].as<string>();
-                }
-                if (data.find("memo") != data.end()) {
-                    memo = data["memo"].as<string>();
-                }
-                if (data.find("quantity") != data.end()) {
-                    quantity = data["quantity"].as<asset>();
+                token_transfer transfer;
+                if (decode_token_transfer(flat.native(i), data, transfer)) {
+                    from = string(transfer.from);
+                    to = string(transfer.to);
+                    memo = transfer.memo;
+                    quantity = transfer.quantity;
+                } else {
+                    if (data.find("from") != data.end()) {
+                        from = data["from"].as<string>();
+                    }
+                    if (data.find("to") != data.end()) {
+                        to = data["to"].as<string>();
+                    }
+                    if (data.find("memo") != data.end()) {
+                        memo = data["memo"].as<string>();
+                    }
+                    if (data.find("quantity") != data.end()) {
+                        quantity = data["quantity"].as<asset>();
+                    }
                 }
                 if (!from || !to || !quantity) {
                     continue;
@@ -456,8 +334,9 @@ struct Transfer : type<Transfer> {
                     ("table_suffix", table_suffix)
                     ("account", account)
                     ("name", name)
-                    ("data", fc::json::to_string(data, fc::json::legacy_generator))
                 ;
+                if (wants("data"))
+                    resobj.set("data", fc::json::to_string(data, fc::json::legacy_generator));
                 if (from) {
                     resobj.set("from", from);
                 }
@@ -471,8 +350,8 @@ struct Transfer : type<Transfer> {
                 if (memo) {
                     resobj.set("memo", memo);
                 }
-                string key = build_action_key(trace);
-                resobj.set("primary_key", key);
+                string key = action_key(trace);
+                resobj.set("primary_key", keys.printable(key));
                 res.push_back({key, resobj});
             }
         }
@@ -484,49 +363,19 @@ static auto _transfer = types().register_type<Transfer>();
 struct Ibc : type<Ibc> {
     key_values build(const transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
         //从transaction中获取所有的action_trace
-        vector<fc::variant> action_traces_vector;
-        if (obj.find("action_traces") != obj.end()) {
-            queue<fc::variant> todo_action_traces;
-            for (auto trace : obj["action_traces"].get_array()) {
-                fc::mutable_variant_object traceobj(trace);
-                traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                traceobj.set("parent_global_sequence", -1);
-                action_traces_vector.push_back(traceobj);
-                if (!trace.get_object()["inline_traces"].get_array().empty())
-                    todo_action_traces.push(trace);
-            }
-            while (!todo_action_traces.empty()) {
-                auto trace = todo_action_traces.front();
-                todo_action_traces.pop();
-                for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
-                    fc::mutable_variant_object traceobj(itrace);
-                    traceobj.set("index_in_transaction", static_cast<uint32_t>(action_traces_vector.size()));
-                    traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
-                    action_traces_vector.push_back(traceobj);
-                    if (!itrace.get_object()["inline_traces"].get_array().empty())
-                        todo_action_traces.push(itrace);
-                }
-            }
-        }
+        const auto& flat = flatten(ttp, obj);
+        const auto& action_traces_vector = flat.actions;
         //基本信息
-        auto block_time = obj["block_time"].as<string>();
         auto block_num  = ttp->block_num;
         auto trx_id = string(ttp->id);
         //计算分表策略
-        fc::optional<string> table_suffix;
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        table_suffix = block_time.substr(0, pos - 2);
+        string table_suffix = this->table_suffix(ttp->block_time);
         //遍历action_trace筛选符合条件的action_trace
         key_values res;
         vector<string> accounts = {"bosibc.io", "eosio.token"};
         vector<string> names = {"transfer"};
-        for (auto var : action_traces_vector) {
-            auto trace = var.get_object();
+        for (size_t i = 0; i < action_traces_vector.size(); i ++) {
+            auto trace = action_traces_vector[i].get_object();
             string account = string(trace["act"].get_object()["account"].as<account_name>());
             string name = string(trace["act"].get_object()["name"].as<account_name>());
             string receiver = string(trace["receipt"].get_object()["receiver"].as<account_name>());
@@ -534,17 +383,25 @@ struct Ibc : type<Ibc> {
                 auto data = trace["act"].get_object()["data"].get_object();
                 fc::optional<string> from, to, memo;
                 fc::optional<asset>  quantity;
-                if (data.find("from") != data.end()) {
-                    from = data["from"].as<string>();
-                }
-                if (data.find("to") != data.end()) {
-                    to = data["to"].as<string>();
-                }
-                if (data.find("memo") != data.end()) {
-                    memo = data["memo"].as<string>();
-                }
-                if (data.find("quantity") != data.end()) {
-                    quantity = data["quantity"].as<asset>();
+                token_transfer transfer;
+                if (decode_token_transfer(flat.native(i), data, transfer)) {
+                    from = string(transfer.from);
+                    to = string(transfer.to);
+                    memo = transfer.memo;
+                    quantity = transfer.quantity;
+                } else {
+                    if (data.find("from") != data.end()) {
+                        from = data["from"].as<string>();
+                    }
+                    if (data.find("to") != data.end()) {
+                        to = data["to"].as<string>();
+                    }
+                    if (data.find("memo") != data.end()) {
+                        memo = data["memo"].as<string>();
+                    }
+                    if (data.find("quantity") != data.end()) {
+                        quantity = data["quantity"].as<asset>();
+                    }
                 }
                 auto resobj= fc::mutable_variant_object
                     ("transaction_id", trx_id)
@@ -553,8 +410,9 @@ struct Ibc : type<Ibc> {
                     ("table_suffix", table_suffix)
                     ("account", account)
                     ("name", name)
-                    ("data", fc::json::to_string(data, fc::json::legacy_generator))
                 ;
+                if (wants("data"))
+                    resobj.set("data", fc::json::to_string(data, fc::json::legacy_generator));
                 if (from) {
                     resobj.set("from", from);
                 }
@@ -571,8 +429,8 @@ struct Ibc : type<Ibc> {
                 if (memo) {
                     resobj.set("memo", memo);
                 }
-                string key = build_action_key(trace);
-                resobj.set("primary_key", key);
+                string key = action_key(trace);
+                resobj.set("primary_key", keys.printable(key));
                 res.push_back({key, resobj});
             }
         }
@@ -1,73 +1,129 @@
-#include <time.h>
-#include <fstream>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
 #include <fc/log/logger.hpp>
 #include <boost/filesystem.hpp>
 #include <appbase/application.hpp>
 #include <eosio/data_plugin/producers.hpp>
+#include <eosio/data_plugin/file_writer.hpp>
 
 namespace eosio {namespace data{
 
-using std::ios;
-using std::ofstream;
 namespace bfs = boost::filesystem;
 
 struct FileProducer : producer<FileProducer> {
     void set_program_options(options_description& cli, options_description& cfg) {
         cfg.add_options()
             ("data-plugin-file-producer-file-name", bpo::value<string>()->default_value("production"),   "the file where to save content")
+            ("data-plugin-file-producer-buffer-kb", bpo::value<uint32_t>()->default_value(4096), "the size of the write buffer, it is written to the file when full")
+            ("data-plugin-file-producer-flush-interval", bpo::value<uint32_t>()->default_value(1000), "the max interval ms between two writes of the buffer")
+            ("data-plugin-file-producer-fsync", bpo::value<string>()->default_value("none"), "when to fsync the file : none, rotate or flush")
+            ("data-plugin-file-producer-io-backend", bpo::value<string>()->default_value("buffered"), "buffered : write() from the writer thread, io_uring : asynchronous writes and fsync through io_uring, falls back to buffered if not available")
+            ("data-plugin-file-producer-uring-buffers", bpo::value<uint32_t>()->default_value(4), "io_uring backend : the buffers of buffer-kb each per file which can be in flight at once")
+            ("data-plugin-file-producer-queue-size", bpo::value<uint32_t>()->default_value(65536), "the max records waiting for the writer thread")
+            ("data-plugin-file-producer-format", bpo::value<string>()->default_value("text"), "text : one line per record, archive : compressed segments with a block_num and type index, columnar : druid structs written by column, one file per struct")
+            ("data-plugin-file-producer-segment-mb", bpo::value<uint32_t>()->default_value(1024), "archive and columnar format : start a new segment when the current one reaches this size")
+            ("data-plugin-file-producer-block-kb", bpo::value<uint32_t>()->default_value(1024), "archive format : the uncompressed size of one compressed block, the records of a block are confirmed once it is full or the segment is closed")
+            ("data-plugin-file-producer-compression", bpo::value<string>()->default_value("zstd"), "archive and columnar format : the codec of the blocks, zstd, gzip or identity")
+            ("data-plugin-file-producer-compression-level", bpo::value<int>()->default_value(0), "archive and columnar format : the compression level, 0 means the default level of the codec")
+            ("data-plugin-file-producer-row-group-rows", bpo::value<uint32_t>()->default_value(100000), "columnar format : the rows buffered before a row group is written")
+            ("data-plugin-file-producer-split-by-name", bpo::value<bool>()->default_value(false), "if true each struct name is written to its own file, named file-name.struct-name")
+            ("data-plugin-file-producer-writer-threads", bpo::value<uint32_t>()->default_value(1), "the number of writer threads when split by name, 0 means one thread per struct name")
         ;
     }
     void initialize(const variables_map& options) {
-        file_path = options["data-plugin-file-producer-file-name"].as<string>(); 
+        bfs::path file_path = options["data-plugin-file-producer-file-name"].as<string>(); 
         if (file_path.is_relative())
             file_path = appbase::app().data_dir() / file_path;
         if(!bfs::exists(file_path.parent_path()))
             bfs::create_directories(file_path.parent_path());
+        writer_config.path = file_path;
+        writer_config.buffer_size = size_t(options["data-plugin-file-producer-buffer-kb"].as<uint32_t>()) * 1024;
+        writer_config.flush_interval_ms = options["data-plugin-file-producer-flush-interval"].as<uint32_t>();
+        writer_config.fsync = file_stream::parse_fsync_policy(options["data-plugin-file-producer-fsync"].as<string>());
+        writer_config.backend = file_output_config::parse_io_backend(options["data-plugin-file-producer-io-backend"].as<string>());
+        writer_config.uring_buffers = std::max<uint32_t>(2, options["data-plugin-file-producer-uring-buffers"].as<uint32_t>());
+#ifndef DATA_PLUGIN_HAVE_URING
+        if (writer_config.backend == file_output_config::backend_uring)
+            wlog ("data-plugin file producer : built without io_uring, use buffered writes");
+#endif
+        writer_config.queue_size = options["data-plugin-file-producer-queue-size"].as<uint32_t>();
+        writer_config.format = file_output_config::parse_format(options["data-plugin-file-producer-format"].as<string>());
+        if (writer_config.format != file_output_config::text) {
+            writer_config.segment_size = uint64_t(options["data-plugin-file-producer-segment-mb"].as<uint32_t>()) * 1024 * 1024;
+            writer_config.block_size = size_t(options["data-plugin-file-producer-block-kb"].as<uint32_t>()) * 1024;
+            writer_config.codec = compressor::parse_codec(options["data-plugin-file-producer-compression"].as<string>());
+            writer_config.compression_level = options["data-plugin-file-producer-compression-level"].as<int>();
+            writer_config.row_group_rows = options["data-plugin-file-producer-row-group-rows"].as<uint32_t>();
+        }
+        writer_config.split_by_name = options["data-plugin-file-producer-split-by-name"].as<bool>();
+        if (writer_config.format == file_output_config::columnar && !writer_config.split_by_name) {
+            ilog ("data-plugin file producer : columnar format writes one file per struct name");
+            writer_config.split_by_name = true;
+        }
+        //without split there is one file, hence one writer
+        writer_threads = writer_config.split_by_name ? options["data-plugin-file-producer-writer-threads"].as<uint32_t>() : 1;
     }
     void startup() {
-        time_t now = time(NULL);
-        tm* t = localtime(&now);
-        if (current_hour != t->tm_hour) {
-            char now_str[16];
-            sprintf(now_str, "%04d%02d%02d%02d", t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour);
-            if (file.is_open())
-                file.close();
-            string file_name = file_path.string() + "." + now_str;
-            file.open(file_name, ios::out | ios::app | ios::binary);
-            if (!file.is_open()) {
-                wlog ("data-plugin file producer : open file ${file} failed", ("file", file_name));
-            }
-            current_hour = t->tm_hour;
+        for (uint32_t i = 0; i < writer_threads; i ++) {
+            writers.emplace_back(std::make_unique<file_writer>());
+            writers.back()->start(writer_config);
         }
     }
     void stop() {
-        if (file.is_open())
-            file.close();
+        for (auto& writer : writers)
+            writer->stop();
+        for (auto& writer : named_writers)
+            writer.second->stop();
     }
     void produce (const string& name, const string& key, fc::variant& value) {
-        time_t now = time(NULL);tm *t = localtime(&now);
-        if (current_hour != t->tm_hour) {
-            char now_str[16];
-            sprintf(now_str, "%04d%02d%02d%02d", t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour);
-            if (file.is_open())
-                file.close();
-            string file_name = file_path.string() + "." + now_str;
-            file.open(file_name, ios::out | ios::app | ios::binary);
-            if (!file.is_open()) {
-                wlog ("data-plugin file producer : open file ${file} failed", ("file", file_name));
+        writer_for(name).push(new file_record{name, key, value});
+    }
+
+    //the records of the block can be in any writer, each one confirms it once it flushed its own
+    void mark(uint32_t block_num) {
+        marked = block_num;
+        for (auto& writer : writers)
+            writer->mark(block_num);
+        std::lock_guard<std::mutex> lock(named_writers_mtx);
+        for (auto& writer : named_writers)
+            writer.second->mark(block_num);
+    }
+
+    uint32_t confirmed() {
+        uint32_t res = marked;
+        for (auto& writer : writers)
+            res = std::min(res, writer->confirmed());
+        std::lock_guard<std::mutex> lock(named_writers_mtx);
+        for (auto& writer : named_writers)
+            res = std::min(res, writer.second->confirmed());
+        return res;
+    }
+
+    //a name always goes to the same writer so that its file is only written by one thread
+    file_writer& writer_for(const string& name) {
+        if (writer_threads == 0) {
+            std::lock_guard<std::mutex> lock(named_writers_mtx);
+            auto& writer = named_writers[name];
+            if (!writer) {
+                writer = std::make_unique<file_writer>();
+                writer->start(writer_config, marked);
             }
-            current_hour = t->tm_hour;
-        }
-        if (file.is_open() && !file.bad() && !file.fail()) {
-            file << name << "\t" << key << "\t" << fc::json::to_string(value, fc::json::legacy_generator) << std::endl; 
-        } else {
-            wlog ("data-plugin file producer : file not open");
+            return *writer;
         }
+        if (writers.size() == 1)
+            return *writers[0];
+        return *writers[std::hash<string>()(name) % writers.size()];
     }
 
-    bfs::path file_path;
-    ofstream file;
-    uint8_t current_hour = 25;
+    file_writer::config writer_config;
+    uint32_t writer_threads = 1;
+    std::vector<std::unique_ptr<file_writer> > writers;
+    std::mutex named_writers_mtx;
+    std::map<string, std::unique_ptr<file_writer> > named_writers;
 };
 static auto _file_producer = producers().register_producer<FileProducer>();
 
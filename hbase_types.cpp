@@ -15,12 +15,16 @@ using namespace chain;
 using key_values = abstract_type::key_values;
 
 struct IrreversibleBlockState : type<IrreversibleBlockState>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const block_state_ptr& bsp, const mutable_variant_object& obj) {
         key_values res;
         if (obj["irreversible"].as<bool>()) {
+            //its own table, the whole block is stored whatever ReversibleBlockState stored
             auto resobj = fc::mutable_variant_object
                 ("primary_key", string(obj["id"].as<block_id_type>()))
-                ("json", fc::json::to_string(obj, fc::json::legacy_generator))
+                (payload_encoding == payload_json ? "json" : "raw", payload(bsp, obj))
             ;
             auto block_time = obj["header"].get_object()["timestamp"].as<block_timestamp_type>();
             resobj.set("timestamp", fc::time_point(block_time).sec_since_epoch());
@@ -33,25 +37,16 @@ struct IrreversibleBlockState : type<IrreversibleBlockState>{
 static auto _irreversible_block_state = eosio::data::types().register_type<IrreversibleBlockState>();
 
 struct ReversibleBlockState : type<ReversibleBlockState>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const block_state_ptr& bsp, const mutable_variant_object& obj) {
         key_values res;
         if (!obj["irreversible"]) {
-            string block_time = obj["header"].get_object()["timestamp"].as<string>();
-            size_t replace_pos = block_time.find("-");
-            while (replace_pos != string::npos) {
-                block_time.replace(replace_pos, 1, "");
-                replace_pos = block_time.find("-");
-            }
-            size_t pos = block_time.find('T');
-            if (pos != string::npos && pos > 2) {
-                if (block_time.length() > pos - 2) {
-                    block_time = block_time.substr(0, pos - 2);
-                }
-            }
             auto resobj = fc::mutable_variant_object
                 ("primary_key", string(obj["id"].as<block_id_type>()))
-                ("json", fc::json::to_string(obj, fc::json::legacy_generator))
-                ("table_suffix", block_time);
+                (payload_encoding == payload_json ? "json" : "raw", payload(bsp, obj))
+                ("table_suffix", table_suffix(bsp->header.timestamp));
             ;
             string key = string(obj["id"].as<block_id_type>());
             res.push_back({key, resobj});
@@ -62,24 +57,15 @@ struct ReversibleBlockState : type<ReversibleBlockState>{
 static auto _reversible_block_state = eosio::data::types().register_type<ReversibleBlockState>();
 
 struct TransactionTrace : type<TransactionTrace>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const transaction_trace_ptr& ttp, const mutable_variant_object& obj) {
         key_values res;
-        string block_time = obj["block_time"].as<string>();
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        if (pos != string::npos && pos > 2) {
-            if (block_time.length() > pos - 2) {
-                block_time = block_time.substr(0, pos - 2);
-            }
-        }
         auto resobj = fc::mutable_variant_object
             ("primary_key", string(obj["id"].as<transaction_id_type>()))
-            ("json", fc::json::to_string(obj, fc::json::legacy_generator))
-            ("table_suffix", block_time);
+            (payload_encoding == payload_json ? "json" : "raw", payload(ttp, obj))
+            ("table_suffix", table_suffix(ttp->block_time));
         ;
         string key = string(obj["id"].as<transaction_id_type>());
         res.push_back({key, resobj});
@@ -89,11 +75,14 @@ struct TransactionTrace : type<TransactionTrace>{
 static auto _transaction_trace = eosio::data::types().register_type<TransactionTrace>();
     
 struct TransactionMetadata : type<TransactionMetadata>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const transaction_metadata_ptr& tmp, const mutable_variant_object& obj) {
         key_values res;
         auto resobj = fc::mutable_variant_object
             ("primary_key", string(tmp->id))
-            ("json", fc::json::to_string(obj, fc::json::legacy_generator))
+            ("json", fc::json::to_string(project(obj), fc::json::legacy_generator))
         ;
         string key = string(tmp->id);
         res.push_back({key, resobj});
@@ -103,13 +92,16 @@ struct TransactionMetadata : type<TransactionMetadata>{
 static auto _transaction_metadata = eosio::data::types().register_type<TransactionMetadata>(); 
 
 struct ActionTrace : type<ActionTrace>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const transaction_trace_ptr& ttp, const mutable_variant_object& obj) {
         key_values res;
         for (auto trace : obj["total_action_traces"].get_array()) {
-            string key = build_action_key(trace.get_object());
+            string key = action_key(trace.get_object());
             auto resobj = fc::mutable_variant_object
-                ("primary_key", key)
-                ("json", fc::json::to_string(trace, fc::json::legacy_generator))
+                ("primary_key", keys.printable(key))
+                ("json", fc::json::to_string(project(trace.get_object()), fc::json::legacy_generator))
             ;
             res.push_back({key, resobj});
         }
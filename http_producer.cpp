@@ -1,5 +1,12 @@
+#include <map>
+#include <deque>
+#include <atomic>
+#include <algorithm>
 #include <string>
+#include <cctype>
+#include <functional>
 #include <boost/asio.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/network/url.hpp>
@@ -8,6 +15,8 @@
 #include <appbase/application.hpp>
 #include <fc/exception/exception.hpp>
 #include <eosio/data_plugin/producers.hpp>
+#include <eosio/data_plugin/disk_queue.hpp>
+#include <eosio/data_plugin/compressor.hpp>
 
 namespace eosio{ namespace data{
 
@@ -18,9 +27,11 @@ using std::shared_ptr;
 using boost::asio::ip::tcp;
 using boost::asio::io_service;
 using boost::asio::deadline_timer;
+namespace bfs = boost::filesystem;
 namespace http = boost::beast::http;
 typedef shared_ptr<tcp::endpoint> endpoint_ptr;
 typedef shared_ptr<http::request<http::string_body> > request_ptr;
+typedef std::function<void(bool)> send_callback;
 
 struct HttpProducer : producer<HttpProducer> {
 
@@ -30,6 +41,14 @@ struct HttpProducer : producer<HttpProducer> {
             ("data-plugin-http-producer-try-num", bpo::value<uint32_t>()->default_value(5), "the maxmium time to retry if failed")
             ("data-plugin-http-producer-retry-interval", bpo::value<uint32_t>()->default_value(1000), "the interval ms between each retry")
             ("data-plugin-http-producer-max-wait", bpo::value<uint32_t>()->default_value(1000), "the max wait time for a request")
+            ("data-plugin-http-producer-retry-queue", bpo::value<bool>()->default_value(false), "if true the requests failed after all retries are saved to disk and replayed in order when the addr recovers")
+            ("data-plugin-http-producer-retry-queue-dir", bpo::value<string>()->default_value("http-retry-queue"), "the dir where to save failed requests, relative to data-dir")
+            ("data-plugin-http-producer-retry-queue-segment-mb", bpo::value<uint32_t>()->default_value(64), "the maximum size of one segment file of the retry queue")
+            ("data-plugin-http-producer-retry-queue-fsync", bpo::value<string>()->default_value("segment"), "when to fsync the retry queue : none, segment or always")
+            ("data-plugin-http-producer-replay-interval", bpo::value<uint32_t>()->default_value(5000), "the interval ms to try replaying the retry queue")
+            ("data-plugin-http-producer-replay-window", bpo::value<uint32_t>()->default_value(64), "the requests of the retry queue written back to back on one kept connection before their answers are read, answers come back in order")
+            ("data-plugin-http-producer-content-encoding", bpo::value<vector<string> >()->composing(), "compress the body sent to an addr, format is addr=gzip|zstd|identity, can have more than one")
+            ("data-plugin-http-producer-compression-level", bpo::value<int>()->default_value(0), "the compression level, 0 means the default level of the codec")
         ;
     }
     void initialize(const variables_map& options) {
@@ -44,40 +63,382 @@ struct HttpProducer : producer<HttpProducer> {
         try_num = options["data-plugin-http-producer-try-num"].as<uint32_t>();
         retry_interval = options["data-plugin-http-producer-retry-interval"].as<uint32_t>();
         max_wait = options["data-plugin-http-producer-max-wait"].as<uint32_t>();
+        replay_interval = options["data-plugin-http-producer-replay-interval"].as<uint32_t>();
+        replay_window = std::max(1u, options["data-plugin-http-producer-replay-window"].as<uint32_t>());
+
+        codecs.resize(urls.size(), compressor::identity);
+        if (options.count("data-plugin-http-producer-content-encoding") > 0) {
+            for (auto encoding : options["data-plugin-http-producer-content-encoding"].as<vector<string> >()) {
+                auto pos = encoding.rfind('=');
+                FC_ASSERT(pos != string::npos, "data-plugin-http-producer-content-encoding should be addr=codec : ${e}", ("e", encoding));
+                auto addr_it = std::find(addrs.begin(), addrs.end(), encoding.substr(0, pos));
+                FC_ASSERT(addr_it != addrs.end(), "content encoding for unknown addr : ${e}", ("e", encoding));
+                codecs[addr_it - addrs.begin()] = compressor::parse_codec(encoding.substr(pos + 1));
+            }
+        }
+        body_compressor = std::make_shared<compressor>(options["data-plugin-http-producer-compression-level"].as<int>());
+
+        if (options["data-plugin-http-producer-retry-queue"].as<bool>()) {
+            bfs::path queue_dir = options["data-plugin-http-producer-retry-queue-dir"].as<string>();
+            if (queue_dir.is_relative())
+                queue_dir = app().data_dir() / queue_dir;
+            uint64_t segment_bytes = uint64_t(options["data-plugin-http-producer-retry-queue-segment-mb"].as<uint32_t>()) * 1024 * 1024;
+            auto fsync = disk_queue::parse_fsync_policy(options["data-plugin-http-producer-retry-queue-fsync"].as<string>());
+            for (auto url : urls) {
+                //one queue per addr so that an addr which is down does not hold back the others
+                string queue_name = string(url);
+                for (auto& c : queue_name) {
+                    if (!isalnum(c)) c = '_';
+                }
+                auto queue = std::make_shared<disk_queue>();
+                queue->open(queue_dir / queue_name, segment_bytes, fsync);
+                retry_queues.push_back(queue);
+            }
+            replaying.resize(urls.size(), false);
+        }
 
         io_worker = std::make_shared<io_service::work>(io);
         io_thread = std::make_shared<thread>([&](){io.run();});
     }
     void startup() {
+        if (!initialized || retry_queues.empty()) return;
+        replay_timer = std::make_shared<deadline_timer>(io);
+        io.post([=](){
+            schedule_replay();
+        });
     }
     void produce (const string& name, const string& key, fc::variant& value) {
         if (!initialized) return;
-        //step1 : crete data
-        auto data = fc::mutable_variant_object
-            ("table", name)
-            ("data" , value)
-        ;
-        auto payload = fc::json::to_string(data, fc::json::legacy_generator);
-        for (auto url : urls) {
-            string path = url.path() ? url.path()->generic_string() : "/";
-            if (url.query()) path += "?" + *url.query();
-            request_ptr request = std::make_shared<http::request<http::string_body>>(http::verb::post, path, 11);
-            request->set(http::field::host, *url.host());
-            request->set(http::field::user_agent, "data-plugin");
-            request->set(http::field::content_type, "application/json");
-            request->keep_alive(true);
-            request->body() = payload;
-            request->prepare_payload();
-            io.post([=](){
-                async_send(key, url, request, 0);
+        //serialization and compression run on the io thread, the caller only hands over the variant
+        fc::variant data = value;
+        held ++;
+        auto seq = tracker.sent();
+        io.post([=](){
+            //every addr settles the record once, all on the io thread : it got it, holds it in its retry
+            //queue or lost it. it is delivered once settled everywhere and lost nowhere
+            auto remaining = std::make_shared<size_t>(urls.size());
+            auto lost = std::make_shared<bool>(false);
+            auto settle = [=](bool delivered) {
+                if (!delivered) *lost = true;
+                if (-- *remaining) return;
+                held --;
+                //a lost record stays outstanding, the delivered block stops before it
+                if (!*lost)
+                    tracker.delivered(seq);
+            };
+            auto done = [=]() {
+                settle(true);
+            };
+            //the record stays outstanding for good, said once
+            auto lose = [=](size_t i, const string& reason) {
+                settle(false);
+                if (checkpoint_stalled) return;
+                checkpoint_stalled = true;
+                wlog ("in http-producer : record lost ${reason}, the checkpoint stays at block ${block} until restart. [key=${key}] [url=${url}]",
+                        ("reason", reason)("block", tracker.confirmed())("key", key)("url", string(urls[i])));
+            };
+            size_t handed = 0;
+            //a record which cannot be serialized, compressed or queued is dropped for the addrs it did not reach,
+            //it is settled for them so the delivered block goes on
+            auto drop = [&](const string& reason) {
+                elog ("in http-producer : record dropped. [name=${name}] [key=${key}] [error=${error}]",
+                        ("name", name)("key", key)("error", reason));
+                for (; handed < urls.size(); handed ++)
+                    done();
+            };
+            try {
+                //step1 : crete data
+                auto payload = std::make_shared<string>(fc::json::to_string(fc::mutable_variant_object
+                    ("table", name)
+                    ("data" , data)
+                , fc::json::legacy_generator));
+                //each codec compresses the payload only once whatever the number of addrs using it
+                std::map<compressor::codec, shared_ptr<string> > bodies;
+                for (; handed < urls.size(); handed ++) {
+                    size_t i = handed;
+                    if (!retry_queues.empty() && !retry_queues[i]->empty()) {
+                        //keep the order : anything new goes behind what is waiting for replay
+                        if (enqueue(i, key, *payload))
+                            done();
+                        else
+                            lose(i, "as the retry queue failed");
+                        continue;
+                    }
+                    auto& body = bodies[codecs[i]];
+                    if (!body)
+                        body = encode(codecs[i], payload);
+                    auto request = build_request(i, *body);
+                    async_send(key, urls[i], request, 0, [=](bool success) {
+                        if (success) {
+                            done();
+                            return;
+                        }
+                        if (retry_queues.empty()) {
+                            lose(i, "without a retry queue");
+                            return;
+                        }
+                        bool queued = false;
+                        try {
+                            queued = enqueue(i, key, *payload);
+                        } catch (const fc::exception& ex) {
+                            elog ("in http-producer : retry queue failed. [key=${key}] [url=${url}] [error=${error}]",
+                                    ("key", key)("url", string(urls[i]))("error", ex.to_string()));
+                        } catch (const std::exception& ex) {
+                            elog ("in http-producer : retry queue failed. [key=${key}] [url=${url}] [error=${error}]",
+                                    ("key", key)("url", string(urls[i]))("error", ex.what()));
+                        }
+                        if (queued)
+                            done();
+                        else
+                            lose(i, "as the retry queue failed");
+                    });
+                }
+            } catch (const fc::exception& ex) {
+                drop(ex.to_string());
+            } catch (const std::exception& ex) {
+                drop(ex.what());
+            }
+        });
+    }
+
+    void mark(uint32_t block_num) {
+        if (!initialized) return;
+        tracker.mark(block_num);
+    }
+    uint32_t confirmed() {
+        return initialized ? tracker.confirmed() : 0;
+    }
+
+    //held in memory plus waiting on disk for replay
+    uint64_t queue_depth() {
+        uint64_t depth = held;
+        for (auto& queue : retry_queues)
+            depth += queue->size();
+        return depth;
+    }
+    //the records some addr has not settled yet : waiting for the io thread or in flight with their
+    //sockets and retry timers. the retry queues are on disk, they absorb an outage on purpose
+    uint64_t memory_depth() {
+        return held;
+    }
+
+    shared_ptr<string> encode(compressor::codec codec, const shared_ptr<string>& payload) {
+        if (codec == compressor::identity) return payload;
+        auto body = std::make_shared<string>();
+        body_compressor->compress(codec, *payload, *body);
+        return body;
+    }
+
+    request_ptr build_request(size_t i, const string& body) {
+        const fc::url& url = urls[i];
+        string path = url.path() ? url.path()->generic_string() : "/";
+        if (url.query()) path += "?" + *url.query();
+        request_ptr request = std::make_shared<http::request<http::string_body>>(http::verb::post, path, 11);
+        request->set(http::field::host, *url.host());
+        request->set(http::field::user_agent, "data-plugin");
+        request->set(http::field::content_type, "application/json");
+        if (codecs[i] != compressor::identity)
+            request->set(http::field::content_encoding, compressor::codec_name(codecs[i]));
+        request->keep_alive(true);
+        request->body() = body;
+        request->prepare_payload();
+        return request;
+    }
+
+    //the retry queue keeps the plain payload, it is encoded again when replayed. false if it is not queued
+    bool enqueue(size_t i, const string& key, const string& payload) {
+        auto packed = fc::raw::pack(std::make_pair(key, payload));
+        return retry_queues[i]->push(string(packed.begin(), packed.end()));
+    }
+
+    void schedule_replay() {
+        replay_timer->expires_from_now(boost::posix_time::milliseconds(replay_interval));
+        replay_timer->async_wait([=](const boost::system::error_code& error) {
+            if (error) return;
+            for (size_t i = 0; i < urls.size(); i ++) {
+                auto depth = retry_queues[i]->size();
+                if (depth == 0) continue;
+                ilog ("in http-producer : retry queue [url=${url}] [depth=${depth}] [oldest_age=${age}s]",
+                        ("url", string(urls[i]))("depth", depth)("age", retry_queues[i]->oldest_age().to_seconds()));
+                replay(i);
+            }
+            schedule_replay();
+        });
+    }
+
+    /**
+     * replays the retry queue of one addr over a kept connection : up to replay_window requests
+     * are written back to back and their answers read in order, so the addr gets the records in
+     * queue order and a record is popped once its answer is read. records queued meanwhile are
+     * taken too, the session ends once the queue is empty. on an error, or no answer within
+     * max-wait, the connection is dropped and what was not answered is sent again on the next
+     * replay.
+     */
+    struct replay_session : std::enable_shared_from_this<replay_session> {
+        replay_session(HttpProducer& p, size_t i) : producer(p), index(i), queue(*p.retry_queues[i]), socket(p.io), deadline(p.io) {}
+
+        void start(const tcp::endpoint& endpoint) {
+            auto self = shared_from_this();
+            queue.rewind();
+            arm();
+            socket.async_connect(endpoint, [self](const boost::system::error_code& error) {
+                if (self->finished) return;
+                if (error) return self->fail("connect failed", error.message());
+                //the requests are small and written back to back, they should not wait for acks
+                boost::system::error_code ec;
+                self->socket.set_option(tcp::no_delay(true), ec);
+                self->fill();
             });
         }
+
+        //write the next record unless the window is full, the queue is drained once nothing is left to answer
+        void fill() {
+            if (finished || writing) return;
+            string item;
+            while (!producer.stopping && pending.size() < producer.replay_window && queue.next(item)) {
+                std::pair<string, string> key_payload;
+                try {
+                    key_payload = fc::raw::unpack<std::pair<string, string> >(item.data(), item.size());
+                } catch (const fc::exception& ex) {
+                    elog ("in http-producer : drop broken record of retry queue [url=${url}] [ex=${ex}]",
+                            ("url", string(producer.urls[index]))("ex", ex.to_string()));
+                    pending.push_back(false);
+                    continue;
+                }
+                request_ptr request;
+                try {
+                    request = producer.build_request(index, *producer.encode(producer.codecs[index], std::make_shared<string>(key_payload.second)));
+                } catch (const fc::exception& ex) {
+                    return fail("cannot encode a record", ex.to_string());
+                } catch (const std::exception& ex) {
+                    return fail("cannot encode a record", ex.what());
+                }
+                pending.push_back(true);
+                write(request);
+                return;
+            }
+            pop_dropped();
+            if (pending.empty())
+                finish();
+        }
+
+        void write(const request_ptr& request) {
+            auto self = shared_from_this();
+            writing = true;
+            http::async_write(socket, *request, [self, request](const boost::system::error_code& error, std::size_t) {
+                self->writing = false;
+                if (self->finished) return;
+                if (error) return self->fail("write failed", error.message());
+                self->read();
+                self->fill();
+            });
+        }
+
+        //the answer of the oldest request written
+        void read() {
+            if (finished || reading) return;
+            pop_dropped();
+            if (pending.empty()) return;
+            auto self = shared_from_this();
+            reading = true;
+            response = std::make_shared<http::response<http::string_body> >();
+            http::async_read(socket, buffer, *response, [self](const boost::system::error_code& error, std::size_t) {
+                self->reading = false;
+                if (self->finished) return;
+                if (error) return self->fail("read failed", error.message());
+                if (self->response->result() != http::status::ok)
+                    return self->fail("response code error", std::to_string(static_cast<int>(self->response->result())));
+                try {
+                    auto result = fc::json::from_string(self->response->body());
+                    if (!(result.is_object() && result.get_object().contains("status") && result.get_object()["status"].as<int>() == 0))
+                        return self->fail("response body error", self->response->body());
+                } catch (const fc::exception& ex) {
+                    return self->fail("response body error", self->response->body());
+                } catch (const std::exception& ex) {
+                    return self->fail("response body error", self->response->body());
+                }
+                self->pending.pop_front();
+                self->queue.pop();
+                self->arm();
+                self->read();
+                self->fill();
+            });
+        }
+
+        //broken records are popped once every record before them is answered
+        void pop_dropped() {
+            while (!pending.empty() && !pending.front()) {
+                pending.pop_front();
+                queue.pop();
+            }
+        }
+
+        void arm() {
+            auto self = shared_from_this();
+            deadline.expires_from_now(boost::posix_time::milliseconds(producer.max_wait));
+            deadline.async_wait([self](const boost::system::error_code& error) {
+                if (error || self->finished) return;
+                self->fail("request timeout", "no answer within max-wait");
+            });
+        }
+
+        void fail(const string& what, const string& reason) {
+            elog ("in http-producer : replay ${what}, retry on the next replay [url=${url}] [error=${error}] [unanswered=${n}]",
+                    ("what", what)("url", string(producer.urls[index]))("error", reason)("n", pending.size()));
+            finish();
+        }
+
+        void finish() {
+            finished = true;
+            deadline.cancel();
+            boost::system::error_code ec;
+            socket.close(ec);
+            producer.replaying[index] = false;
+        }
+
+        HttpProducer& producer;
+        size_t index;
+        disk_queue& queue;
+        tcp::socket socket;
+        deadline_timer deadline;
+        boost::beast::flat_buffer buffer;
+        shared_ptr<http::response<http::string_body> > response;
+        //the records taken from the queue in order, false for a broken one which is not sent
+        std::deque<bool> pending;
+        bool writing = false;
+        bool reading = false;
+        bool finished = false;
+    };
+
+    void replay(size_t i) {
+        if (replaying[i] || retry_queues[i]->empty()) return;
+        const fc::url& url = urls[i];
+        boost::system::error_code errorcode;
+        tcp::resolver resolver(io);
+        tcp::resolver::query query(*url.host(), url.port() ? std::to_string(*url.port()) : "80");
+        auto resolver_it = resolver.resolve(query, errorcode);
+        if (errorcode) {
+            elog ("data-plugin : http-producer : resolve addr ${host}:${port} failed . reason : ${reason}",
+                    ("host", *url.host())("port", url.port() ? *url.port() : 80)("reason", errorcode.message()));
+            return;
+        }
+        replaying[i] = true;
+        std::make_shared<replay_session>(*this, i)->start(resolver_it->endpoint());
     }
 
-    void async_send(const std::string key, fc::url url, const request_ptr request, int loop) {
+    void async_send(const std::string key, fc::url url, const request_ptr request, int loop, send_callback done) {
         if (loop > try_num) {
-            elog ("in http-producer : request failed. [key=${key}] [url=${url}] [data=${data}]",
-                    ("key", key)("url", string(url))("data", request->body()));
+            if (retry_queues.empty() && request->count(http::field::content_encoding)) {
+                elog ("in http-producer : request failed. [key=${key}] [url=${url}] [size=${size}]",
+                        ("key", key)("url", string(url))("size", request->body().size()));
+            } else if (retry_queues.empty()) {
+                elog ("in http-producer : request failed. [key=${key}] [url=${url}] [data=${data}]",
+                        ("key", key)("url", string(url))("data", request->body()));
+            } else {
+                elog ("in http-producer : request failed, keep it in retry queue. [key=${key}] [url=${url}]",
+                        ("key", key)("url", string(url)));
+            }
+            done(false);
             return;
         } else if (loop > 0) {
             elog ("in http-producer : request error. try again(${loop}/${try_num}). [key=${key}] [url=${url}]",
@@ -89,7 +450,13 @@ struct HttpProducer : producer<HttpProducer> {
         auto resolver_it = resolver.resolve(query, errorcode);
         if (errorcode) {
             elog ("data-plugin : http-producer : resolve addr ${host}:${port} failed . reason : ${reason}",
-                    ("addr", *url.host())("port", *url.port())("reason", errorcode.message()));
+                    ("host", *url.host())("port", url.port() ? *url.port() : 80)("reason", errorcode.message()));
+            auto retry = std::make_shared<deadline_timer>(io, boost::posix_time::milliseconds(retry_interval));
+            retry->async_wait([=](const boost::system::error_code& error) {
+                retry->cancel();
+                async_send(key, url, request, loop + 1, done);
+            });
+            return;
         }
         auto endpoint = std::make_shared<tcp::endpoint>(resolver_it->endpoint());
 
@@ -122,7 +489,7 @@ struct HttpProducer : producer<HttpProducer> {
                     elog ("retry timer error : ${ex}", ("ex", error.message()));
                 }
                 retry->cancel();
-                async_send(key, url, request, loop + 1);
+                async_send(key, url, request, loop + 1, done);
             });
         });
         //step2 : connect
@@ -146,8 +513,9 @@ struct HttpProducer : producer<HttpProducer> {
                         elog ("retry timer error : ${ex}", ("ex", error.message()));
                     }
                     retry->cancel();
-                    async_send(key, url, request, loop + 1);
+                    async_send(key, url, request, loop + 1, done);
                 });
+                return;
             }
             dlog ("connect finish [key=${key}] [url=${url}]", ("key", key)("url", string(url)));
             //step3 : send
@@ -172,8 +540,9 @@ struct HttpProducer : producer<HttpProducer> {
                             elog ("retry timer error : ${ex}", ("ex", error.message()));
                         }
                         retry->cancel();
-                        async_send(key, url, request, loop + 1);
+                        async_send(key, url, request, loop + 1, done);
                     });
+                    return;
                 }
                 dlog ("write finish [key=${key}] [url=${url}]", ("key", key)("url", string(url)));
                 //step4 : read
@@ -202,15 +571,15 @@ struct HttpProducer : producer<HttpProducer> {
                                 elog ("retry timer error : ${ex}", ("ex", error.message()));
                             }
                             retry->cancel();
-                            async_send(key, url, request, loop + 1);
+                            async_send(key, url, request, loop + 1, done);
                         });
+                        return;
                     }
                     dlog ("read finish [key=${key}] [url=${url}] [code=${code}]", 
                         ("key", key)("url", string(url))("code", static_cast<int>(response->result())));
                     //step5 : analyse
-                    printf ("test123\n");
                     if (response->result() != http::status::ok) {
-                        elog ("in http-producer : response code error [key=${key}] [url=${ur}] [code=${code}]",
+                        elog ("in http-producer : response code error [key=${key}] [url=${url}] [code=${code}]",
                                 ("key", key)("url", string(url))("code", static_cast<int>(response->result())));
                         *canceled = true;
                         if (socket->is_open()) {
@@ -224,7 +593,7 @@ struct HttpProducer : producer<HttpProducer> {
                                 elog ("retry timer error : ${ex}", ("ex", error.message()));
                             }
                             retry->cancel();
-                            async_send(key, url, request, loop + 1);
+                            async_send(key, url, request, loop + 1, done);
                         });
                         return;
                     }
@@ -251,7 +620,7 @@ struct HttpProducer : producer<HttpProducer> {
                                 elog ("retry timer error : ${ex}", ("ex", error.message()));
                             }
                             retry->cancel();
-                            async_send(key, url, request, loop + 1);
+                            async_send(key, url, request, loop + 1, done);
                         });
                         return;
                     } catch (const fc::eof_exception& ex) {
@@ -269,7 +638,7 @@ struct HttpProducer : producer<HttpProducer> {
                                 elog ("retry timer error : ${ex}", ("ex", error.message()));
                             }
                             retry->cancel();
-                            async_send(key, url, request, loop + 1);
+                            async_send(key, url, request, loop + 1, done);
                         });
                         return;
                     } catch (const std::exception& ex) {
@@ -287,23 +656,29 @@ struct HttpProducer : producer<HttpProducer> {
                                 elog ("retry timer error : ${ex}", ("ex", error.message()));
                             }
                             retry->cancel();
-                            async_send(key, url, request, loop + 1);
+                            async_send(key, url, request, loop + 1, done);
                         });
                         return;
                     }
                     dlog ("produce finish [key=${key} [url=${url}]", ("key", key)("url", string(url)));
                     *canceled = true;
                     deadline->cancel();
+                    done(true);
                 });
             });
         });
     }
     void stop() {
+        if (!initialized) return;
         ilog ("data-plugin http-producer begin stop");
         io.post([=](){
+            stopping = true;
+            if (replay_timer) replay_timer->cancel();
             io_worker.reset();
         });
         io_thread->join();
+        for (auto queue : retry_queues)
+            queue->close();
         ilog ("data-plugin http-producer stop finish");
     }
 
@@ -311,7 +686,20 @@ struct HttpProducer : producer<HttpProducer> {
     uint32_t try_num;
     uint32_t retry_interval;
     uint32_t max_wait;
-    bool initialized;
+    uint32_t replay_interval;
+    uint32_t replay_window;
+    vector<compressor::codec> codecs;
+    shared_ptr<compressor> body_compressor;
+    bool initialized = false;
+    vector<shared_ptr<disk_queue> > retry_queues;
+    vector<bool> replaying;
+    //no replay goes on once stop began, only touched on the io thread
+    bool stopping = false;
+    shared_ptr<deadline_timer> replay_timer;
+    std::atomic<uint64_t> held{0};
+    delivery_tracker tracker;
+    //a record was lost, only touched on the io thread
+    bool checkpoint_stalled = false;
     io_service io;
     shared_ptr<io_service::work> io_worker;
     shared_ptr<thread> io_thread;
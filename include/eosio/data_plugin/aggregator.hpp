@@ -0,0 +1,241 @@
+#pragma once
+
+#include <map>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <fc/time.hpp>
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+#include <fc/crypto/city.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+using std::vector;
+using std::pair;
+
+/**
+ * hyperloglog distinct count estimate with 2^precision one byte registers
+ */
+struct hll_sketch {
+    explicit hll_sketch(uint8_t p = 11) : precision(p), registers(size_t(1) << p, 0) {}
+
+    void add(uint64_t hash) {
+        uint64_t index = hash >> (64 - precision);
+        uint64_t rest = (hash << precision) | (uint64_t(1) << (precision - 1));
+        uint8_t rank = uint8_t(__builtin_clzll(rest) + 1);
+        if (rank > registers[index])
+            registers[index] = rank;
+    }
+
+    uint64_t estimate() const {
+        double m = registers.size();
+        double sum = 0;
+        uint32_t zeros = 0;
+        for (auto r : registers) {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) zeros ++;
+        }
+        double alpha = 0.7213 / (1 + 1.079 / m);
+        double e = alpha * m * m / sum;
+        //small range correction
+        if (e <= 2.5 * m && zeros)
+            e = m * std::log(m / zeros);
+        return uint64_t(e + 0.5);
+    }
+
+    uint8_t precision;
+    vector<uint8_t> registers;
+};
+
+/**
+ * tumbling windows on the block time of the records of one struct.
+ *
+ * records are grouped by window and by the values of the dimension fields; every group
+ * keeps a record count, sums of numeric fields and distinct count sketches. a window is
+ * produced once the irreversible block time reaches its end, so a window is complete as
+ * long as the chain does not fork past irreversibility.
+ *
+ * configured as window=60;dims=actor,receiver;metrics=count,sum:cpu_usage_us,distinct:trx
+ * with optional time=<time field> (block_time) and precision=<hll precision> (11).
+ */
+struct window_aggregator {
+    typedef vector<pair<string, fc::variant> > key_values;
+
+    struct metric {
+        enum metric_type { count, sum, distinct };
+        metric_type type;
+        string field;
+        string output;
+    };
+
+    explicit window_aggregator(const string& spec) {
+        vector<string> items;
+        boost::split(items, spec, boost::is_any_of(";"));
+        for (auto& item : items) {
+            if (item.empty()) continue;
+            auto pos = item.find('=');
+            FC_ASSERT(pos != string::npos, "aggregate option should be name=value : ${i}", ("i", item));
+            auto name = item.substr(0, pos);
+            auto value = item.substr(pos + 1);
+            if (name == "window") {
+                window_sec = std::stoul(value);
+                FC_ASSERT(window_sec > 0, "aggregate window should be more than 0 seconds");
+            } else if (name == "time") {
+                time_field = value;
+            } else if (name == "precision") {
+                precision = std::stoul(value);
+                FC_ASSERT(precision >= 4 && precision <= 16, "aggregate precision should be in [4, 16]");
+            } else if (name == "dims") {
+                boost::split(dims, value, boost::is_any_of(","));
+            } else if (name == "metrics") {
+                vector<string> names;
+                boost::split(names, value, boost::is_any_of(","));
+                for (auto& m : names)
+                    metrics.push_back(parse_metric(m));
+            } else {
+                FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown aggregate option ${i}", ("i", item));
+            }
+        }
+        if (metrics.empty())
+            metrics.push_back(parse_metric("count"));
+    }
+
+    void add(const fc::variant& record) {
+        if (!record.is_object()) return;
+        auto& obj = record.get_object();
+        auto t = obj.find(time_field);
+        if (t == obj.end()) return;
+        int64_t window = record_sec(t->value()) / window_sec * window_sec;
+
+        string dim_key;
+        for (auto& dim : dims) {
+            auto it = obj.find(dim);
+            if (it != obj.end())
+                dim_key += it->value().is_string() ? it->value().get_string() : fc::json::to_string(it->value());
+            dim_key += '\x1f';
+        }
+        auto& g = windows[window][dim_key];
+        if (g.sums.empty() && g.sketches.empty()) {
+            g.sums.resize(metrics.size(), 0);
+            for (auto& m : metrics)
+                if (m.type == metric::distinct)
+                    g.sketches.emplace_back(precision);
+        }
+        g.count ++;
+        size_t sketch = 0;
+        for (size_t i = 0; i < metrics.size(); i ++) {
+            auto& m = metrics[i];
+            if (m.type == metric::count) continue;
+            auto it = obj.find(m.field);
+            if (m.type == metric::sum) {
+                if (it != obj.end() && it->value().is_numeric())
+                    g.sums[i] += it->value().as_double();
+            } else {
+                if (it != obj.end()) {
+                    string v = it->value().is_string() ? it->value().get_string() : fc::json::to_string(it->value());
+                    g.sketches[sketch].add(fc::city_hash64(v.data(), v.size()));
+                }
+                sketch ++;
+            }
+        }
+    }
+
+    //the groups of every window ending at or before the irreversible block time
+    key_values flush(const fc::time_point& irreversible_time) {
+        return flush_before(irreversible_time.sec_since_epoch());
+    }
+
+    //every open window, when the plugin stops
+    key_values flush_all() {
+        return flush_before(INT64_MAX);
+    }
+
+    size_t open_windows() const {
+        return windows.size();
+    }
+
+private:
+    struct group {
+        uint64_t count = 0;
+        vector<double> sums;
+        vector<hll_sketch> sketches;
+    };
+
+    static metric parse_metric(const string& m) {
+        auto pos = m.find(':');
+        auto type = m.substr(0, pos);
+        auto field = pos == string::npos ? string() : m.substr(pos + 1);
+        if (type == "count")
+            return {metric::count, "", "count"};
+        FC_ASSERT(!field.empty(), "aggregate metric ${m} should be sum:field or distinct:field", ("m", m));
+        if (type == "sum")
+            return {metric::sum, field, "sum_" + field};
+        if (type == "distinct")
+            return {metric::distinct, field, "distinct_" + field};
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown aggregate metric ${m}, expect count/sum/distinct", ("m", m));
+    }
+
+    //the block time of a record, the string of the previous record is usually the same
+    int64_t record_sec(const fc::variant& v) {
+        if (v.is_numeric()) return v.as_int64();
+        auto& s = v.get_string();
+        if (s != last_time) {
+            last_time = s;
+            last_sec = fc::time_point::from_iso_string(s).sec_since_epoch();
+        }
+        return last_sec;
+    }
+
+    key_values flush_before(int64_t sec) {
+        key_values res;
+        while (!windows.empty() && (sec == INT64_MAX || windows.begin()->first + int64_t(window_sec) <= sec)) {
+            auto begin = windows.begin()->first;
+            auto start = string(fc::time_point_sec(uint32_t(begin)));
+            auto end = string(fc::time_point_sec(uint32_t(begin + window_sec)));
+            for (auto& kv : windows.begin()->second) {
+                auto& g = kv.second;
+                fc::mutable_variant_object resobj;
+                resobj("window_start", start)("window_end", end);
+                vector<string> values;
+                boost::split(values, kv.first, boost::is_any_of("\x1f"));
+                for (size_t i = 0; i < dims.size(); i ++)
+                    resobj(dims[i], values[i]);
+                size_t sketch = 0;
+                for (size_t i = 0; i < metrics.size(); i ++) {
+                    auto& m = metrics[i];
+                    if (m.type == metric::count)
+                        resobj(m.output, g.count);
+                    else if (m.type == metric::sum)
+                        resobj(m.output, g.sums[i]);
+                    else
+                        resobj(m.output, g.sketches[sketch ++].estimate());
+                }
+                string key = start;
+                for (size_t i = 0; i < dims.size(); i ++)
+                    key += "|" + values[i];
+                res.push_back({key, fc::variant(resobj)});
+            }
+            windows.erase(windows.begin());
+        }
+        return res;
+    }
+
+    uint32_t window_sec = 60;
+    string time_field = "block_time";
+    uint8_t precision = 11;
+    vector<string> dims;
+    vector<metric> metrics;
+    map<int64_t, std::unordered_map<string, group> > windows;
+    string last_time;
+    int64_t last_sec = 0;
+};
+
+}}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <fc/exception/exception.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+using std::vector;
+
+/**
+ * the blocks the data plugin builds records for, as sorted disjoint ranges of block
+ * numbers. a range is configured as first-last, or first- for no end. every block by
+ * default; no block at all once what is left has been dropped by a checkpoint.
+ */
+struct block_ranges {
+    struct range {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    block_ranges() : ranges{{0, UINT32_MAX}} {}
+
+    static block_ranges parse(const vector<string>& specs) {
+        block_ranges res;
+        res.ranges.clear();
+        for (auto& spec : specs) {
+            auto pos = spec.find('-');
+            FC_ASSERT(pos != string::npos && pos > 0 && pos <= 10 && spec.size() - pos <= 11
+                      && std::all_of(spec.begin(), spec.end(), [](char c) { return c == '-' || (c >= '0' && c <= '9'); })
+                      && spec.find('-', pos + 1) == string::npos,
+                      "data-plugin-range should be first-last or first- : ${s}", ("s", spec));
+            auto first = uint32_t(std::stoull(spec.substr(0, pos)));
+            auto last = pos + 1 == spec.size() ? UINT32_MAX : uint32_t(std::stoull(spec.substr(pos + 1)));
+            res.add(first, last);
+        }
+        return res;
+    }
+
+    void add(uint32_t first, uint32_t last) {
+        FC_ASSERT(first <= last, "empty block range ${f}-${l}", ("f", first)("l", last));
+        auto it = std::lower_bound(ranges.begin(), ranges.end(), first,
+                                   [](const range& r, uint32_t num) { return uint64_t(r.last) + 1 < num; });
+        //merged with every range it touches
+        while (it != ranges.end() && it->first <= uint64_t(last) + 1) {
+            first = std::min(first, it->first);
+            last = std::max(last, it->last);
+            it = ranges.erase(it);
+        }
+        ranges.insert(it, {first, last});
+    }
+
+    bool contains(uint32_t num) const {
+        auto it = std::lower_bound(ranges.begin(), ranges.end(), num,
+                                   [](const range& r, uint32_t n) { return r.last < n; });
+        return it != ranges.end() && it->first <= num;
+    }
+
+    //nothing is left after num, the blocks after it can be ignored
+    bool past_end(uint32_t num) const {
+        return ranges.empty() || (ranges.back().last != UINT32_MAX && num >= ranges.back().last);
+    }
+
+    //drops the blocks up to num, already delivered
+    void start_after(uint32_t num) {
+        while (!ranges.empty() && ranges.front().last <= num)
+            ranges.erase(ranges.begin());
+        if (!ranges.empty())
+            ranges.front().first = std::max(ranges.front().first, num + 1);
+    }
+
+    string to_string() const {
+        string res;
+        for (auto& r : ranges) {
+            if (!res.empty()) res += ",";
+            res += std::to_string(r.first) + "-" + (r.last == UINT32_MAX ? string() : std::to_string(r.last));
+        }
+        return res;
+    }
+
+    vector<range> ranges;
+};
+
+}}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fc/io/json.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/filesystem.hpp>
+
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+
+/**
+ * the last irreversible block each producer has delivered completely, kept in a small json
+ * file. a save writes a temporary file, fsyncs it and renames it over the old one, so the
+ * file is always either the previous or the new checkpoint.
+ */
+struct checkpoint_file {
+    typedef map<string, uint32_t> positions;
+
+    explicit checkpoint_file(const boost::filesystem::path& p = boost::filesystem::path()) : path(p) {}
+
+    positions load() const {
+        positions res;
+        if (path.empty() || !boost::filesystem::exists(path)) return res;
+        try {
+            auto obj = fc::json::from_file(fc::path(path.string())).get_object();
+            for (auto& kv : obj["producers"].get_object())
+                res[kv.key()] = kv.value().as<uint32_t>();
+        } catch (const fc::exception& ex) {
+            wlog ("data-plugin checkpoint ${p} unreadable, ignored : ${ex}", ("p", path.string())("ex", ex.to_string()));
+            res.clear();
+        }
+        return res;
+    }
+
+    bool save(const positions& pos) const {
+        fc::mutable_variant_object producers;
+        for (auto& kv : pos)
+            producers(kv.first, kv.second);
+        auto body = fc::json::to_pretty_string(fc::mutable_variant_object("producers", producers));
+        auto tmp = path.string() + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            elog ("data-plugin checkpoint ${p} cannot be written", ("p", tmp));
+            return false;
+        }
+        bool ok = ::write(fd, body.data(), body.size()) == ssize_t(body.size()) && ::fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(tmp.c_str(), path.string().c_str()) != 0) {
+            elog ("data-plugin checkpoint ${p} cannot be written", ("p", path.string()));
+            return false;
+        }
+        //the rename itself is durable once the directory is synced
+        int dir = ::open(path.parent_path().string().c_str(), O_RDONLY);
+        if (dir >= 0) {
+            ::fsync(dir);
+            ::close(dir);
+        }
+        return true;
+    }
+
+    //the block to resume after : what every given producer has delivered
+    static uint32_t resume_after(const positions& pos, const std::vector<string>& producers) {
+        uint32_t res = 0;
+        bool first = true;
+        for (auto& name : producers) {
+            auto it = pos.find(name);
+            uint32_t num = it == pos.end() ? 0 : it->second;
+            res = first ? num : std::min(res, num);
+            first = false;
+        }
+        return res;
+    }
+
+    boost::filesystem::path path;
+};
+
+}}
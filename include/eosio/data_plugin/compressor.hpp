@@ -0,0 +1,173 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <zlib.h>
+#include <fc/exception/exception.hpp>
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+/**
+ * gzip/zstd (de)compression with contexts which are kept and reset between calls.
+ * one compressor must only be used by one thread at a time.
+ */
+struct compressor {
+    enum codec {
+        identity = 0,
+        gzip     = 1,
+        zstd     = 2,
+    };
+
+    static codec parse_codec(const string& name) {
+        if (name == "identity" || name == "none" || name.empty()) return identity;
+        if (name == "gzip") return gzip;
+        if (name == "zstd") {
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+            return zstd;
+#else
+            FC_THROW_EXCEPTION(fc::invalid_arg_exception, "data_plugin is built without zstd support");
+#endif
+        }
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown codec ${c}, expect identity/gzip/zstd", ("c", name));
+    }
+
+    //the token used in http Content-Encoding
+    static const char* codec_name(codec c) {
+        switch (c) {
+            case gzip: return "gzip";
+            case zstd: return "zstd";
+            default:   return "identity";
+        }
+    }
+
+    explicit compressor(int level = 0) : level(level) {}
+    compressor(const compressor&) = delete;
+    compressor& operator=(const compressor&) = delete;
+
+    ~compressor() {
+        if (gzip_ready)
+            deflateEnd(&gzip_stream);
+        if (gunzip_ready)
+            inflateEnd(&gunzip_stream);
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+        if (zstd_ctx)
+            ZSTD_freeCCtx(zstd_ctx);
+        if (zstd_dctx)
+            ZSTD_freeDCtx(zstd_dctx);
+#endif
+    }
+
+    void compress(codec c, const char* data, size_t len, string& out) {
+        switch (c) {
+            case gzip: compress_gzip(data, len, out); break;
+            case zstd: compress_zstd(data, len, out); break;
+            default:   out.assign(data, len); break;
+        }
+    }
+
+    void compress(codec c, const string& in, string& out) {
+        compress(c, in.data(), in.size(), out);
+    }
+
+    void decompress(codec c, const char* data, size_t len, string& out) {
+        switch (c) {
+            case gzip: decompress_gzip(data, len, out); break;
+            case zstd: decompress_zstd(data, len, out); break;
+            default:   out.assign(data, len); break;
+        }
+    }
+
+    void decompress(codec c, const string& in, string& out) {
+        decompress(c, in.data(), in.size(), out);
+    }
+
+private:
+    void compress_gzip(const char* data, size_t len, string& out) {
+        if (!gzip_ready) {
+            //15 + 16 : max window with a gzip header instead of a zlib one
+            auto ret = deflateInit2(&gzip_stream, level > 0 ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            FC_ASSERT(ret == Z_OK, "deflateInit2 failed : ${ret}", ("ret", ret));
+            gzip_ready = true;
+        } else {
+            deflateReset(&gzip_stream);
+        }
+        //deflateBound does not count the gzip header and trailer
+        out.resize(deflateBound(&gzip_stream, len) + 18);
+        gzip_stream.next_in = (Bytef*)data;
+        gzip_stream.avail_in = len;
+        gzip_stream.next_out = (Bytef*)&out[0];
+        gzip_stream.avail_out = out.size();
+        auto ret = deflate(&gzip_stream, Z_FINISH);
+        FC_ASSERT(ret == Z_STREAM_END, "gzip compress failed : ${ret}", ("ret", ret));
+        out.resize(gzip_stream.total_out);
+    }
+
+    void compress_zstd(const char* data, size_t len, string& out) {
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+        if (!zstd_ctx)
+            zstd_ctx = ZSTD_createCCtx();
+        out.resize(ZSTD_compressBound(len));
+        auto size = ZSTD_compressCCtx(zstd_ctx, &out[0], out.size(), data, len, level > 0 ? level : 3);
+        FC_ASSERT(!ZSTD_isError(size), "zstd compress failed : ${err}", ("err", ZSTD_getErrorName(size)));
+        out.resize(size);
+#else
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "data_plugin is built without zstd support");
+#endif
+    }
+
+    void decompress_gzip(const char* data, size_t len, string& out) {
+        if (!gunzip_ready) {
+            auto ret = inflateInit2(&gunzip_stream, 15 + 16);
+            FC_ASSERT(ret == Z_OK, "inflateInit2 failed : ${ret}", ("ret", ret));
+            gunzip_ready = true;
+        } else {
+            inflateReset(&gunzip_stream);
+        }
+        out.resize(std::max<size_t>(len * 4, 4096));
+        gunzip_stream.next_in = (Bytef*)data;
+        gunzip_stream.avail_in = len;
+        while (true) {
+            gunzip_stream.next_out = (Bytef*)&out[0] + gunzip_stream.total_out;
+            gunzip_stream.avail_out = out.size() - gunzip_stream.total_out;
+            auto ret = inflate(&gunzip_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) break;
+            FC_ASSERT(ret == Z_OK || ret == Z_BUF_ERROR, "gzip decompress failed : ${ret}", ("ret", ret));
+            FC_ASSERT(gunzip_stream.avail_out == 0, "gzip decompress failed : truncated input");
+            out.resize(out.size() * 2);
+        }
+        out.resize(gunzip_stream.total_out);
+    }
+
+    void decompress_zstd(const char* data, size_t len, string& out) {
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+        if (!zstd_dctx)
+            zstd_dctx = ZSTD_createDCtx();
+        auto content_size = ZSTD_getFrameContentSize(data, len);
+        FC_ASSERT(content_size != ZSTD_CONTENTSIZE_ERROR && content_size != ZSTD_CONTENTSIZE_UNKNOWN,
+                  "zstd decompress failed : unknown content size");
+        out.resize(content_size);
+        auto size = ZSTD_decompressDCtx(zstd_dctx, &out[0], out.size(), data, len);
+        FC_ASSERT(!ZSTD_isError(size), "zstd decompress failed : ${err}", ("err", ZSTD_getErrorName(size)));
+        out.resize(size);
+#else
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "data_plugin is built without zstd support");
+#endif
+    }
+
+    int level;
+    bool gzip_ready = false;
+    z_stream gzip_stream = {};
+    bool gunzip_ready = false;
+    z_stream gunzip_stream = {};
+#ifdef DATA_PLUGIN_HAVE_ZSTD
+    ZSTD_CCtx* zstd_ctx = nullptr;
+    ZSTD_DCtx* zstd_dctx = nullptr;
+#endif
+};
+
+}}
@@ -1,7 +1,15 @@
 #pragma once
+#include <map>
 #include <queue>
+#include <memory>
+#include <boost/asio/signal_set.hpp>
 #include <appbase/application.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/data_plugin/fork_buffer.hpp>
+#include <eosio/data_plugin/checkpoint.hpp>
+#include <eosio/data_plugin/block_range.hpp>
+#include <eosio/data_plugin/projection.hpp>
+#include <eosio/data_plugin/emission_limit.hpp>
 
 namespace eosio {
 
@@ -21,17 +29,50 @@ public:
     void plugin_shutdown();
 
 private:
+    //what a reload can change, swapped as a whole between two blocks
+    struct dispatch_config {
+        vector<string> types;
+        vector<string> producers;
+        std::map<string, std::shared_ptr<eosio::data::emission_limit> > limits;
+        std::map<string, std::shared_ptr<eosio::data::field_projection> > projections;
+    };
+
+    static std::shared_ptr<const dispatch_config> load_dispatch(const variables_map& options);
+    variables_map config_file_options();
+    variables_map merge_reloaded(const variables_map& file_options);
+    void reload();
+    void schedule_reload();
+    void switch_config();
+    void schedule_metrics();
+    void save_checkpoint();
+    void stop_after_drain();
 
     boost::signals2::connection on_accepted_block_connection;
     boost::signals2::connection on_irreversible_block_connection;
     boost::signals2::connection on_applied_transaction_connection;
     boost::signals2::connection on_accepted_transaction_connection;
     
-    uint32_t start_block_num;
-    uint32_t stop_block_num;
-    vector<string> types;
-    vector<string> producers;
+    //the blocks records are built for, checked on the block of each event before it is converted
+    eosio::data::block_ranges ranges;
+    //the last range is done, waiting for nodeos to quit
+    bool stopping = false;
+    //events take the configuration when they start, a reload waits in pending_config until the block ends
+    std::shared_ptr<const dispatch_config> config;
+    std::shared_ptr<const dispatch_config> pending_config;
+    std::shared_ptr<boost::asio::signal_set> reload_signals;
+    //the options nodeos started with and what config.ini held then, a reload keeps what the command line set
+    variables_map startup_options;
+    variables_map startup_file_options;
     uint32_t current_block_num;
+    //reversible records waiting for their fork to settle
+    eosio::data::fork_buffer fork;
+    //the period of the metrics log line in seconds, 0 if off
+    uint32_t metrics_interval = 0;
+    std::shared_ptr<boost::asio::deadline_timer> metrics_timer;
+    //the blocks each producer delivered, saved every checkpoint_interval irreversible blocks, 0 if off
+    eosio::data::checkpoint_file checkpoint;
+    eosio::data::checkpoint_file::positions checkpoint_positions;
+    uint32_t checkpoint_interval = 0;
 };
 
 }
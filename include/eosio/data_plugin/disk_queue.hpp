@@ -0,0 +1,394 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/stat.h>
+#include <fc/time.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/filesystem.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+using std::vector;
+
+/**
+ * append-only fifo persisted under one directory as numbered segment files.
+ * every record is stored as [uint32 size][int64 enqueue time in us][payload],
+ * the read position lives in the file "cursor" which is replaced atomically.
+ * consumed segments are deleted once the reader moves past them. next reads ahead of
+ * the front without removing anything, for readers with several records in flight.
+ */
+struct disk_queue {
+    enum fsync_policy {
+        fsync_none,     //leave it to the page cache
+        fsync_segment,  //fsync a segment when it is rotated and the cursor when it is saved
+        fsync_always    //fsync after every push
+    };
+
+    static fsync_policy parse_fsync_policy(const string& policy) {
+        if (policy == "none")    return fsync_none;
+        if (policy == "segment") return fsync_segment;
+        if (policy == "always")  return fsync_always;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown fsync policy ${p}, expect none/segment/always", ("p", policy));
+    }
+
+    ~disk_queue() {
+        close();
+    }
+
+    void open(const boost::filesystem::path& queue_dir, uint64_t segment_bytes, fsync_policy fsync) {
+        namespace bfs = boost::filesystem;
+        std::lock_guard<std::mutex> lock(mtx);
+        dir = queue_dir;
+        max_segment_bytes = segment_bytes;
+        policy = fsync;
+        if (!bfs::exists(dir))
+            bfs::create_directories(dir);
+
+        vector<uint64_t> seqs;
+        for (bfs::directory_iterator it(dir), end; it != end; ++it) {
+            if (it->path().extension() != ".seg") continue;
+            seqs.push_back(std::stoull(it->path().stem().string()));
+        }
+        std::sort(seqs.begin(), seqs.end());
+        read_seq = seqs.empty() ? 0 : seqs.front();
+        read_offset = 0;
+        load_cursor();
+        write_seq = seqs.empty() ? read_seq : std::max(seqs.back(), read_seq);
+
+        count = 0;
+        for (auto seq : seqs) {
+            if (seq < read_seq) {
+                bfs::remove(segment_path(seq));
+                continue;
+            }
+            count += scan_segment(seq, seq == read_seq ? read_offset : 0, seq == write_seq);
+        }
+        open_write_segment();
+        reset_ahead();
+        if (count > 0)
+            ilog ("data-plugin disk queue ${dir} : ${count} records pending", ("dir", dir.string())("count", count));
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (write_fd >= 0) {
+            if (policy != fsync_none) ::fsync(write_fd);
+            ::close(write_fd);
+            write_fd = -1;
+            save_cursor();
+        }
+        if (read_fd >= 0) {
+            ::close(read_fd);
+            read_fd = -1;
+        }
+        if (ahead_fd >= 0) {
+            ::close(ahead_fd);
+            ahead_fd = -1;
+        }
+    }
+
+    //false if the record is not in the queue, nothing of it is left in the segment then
+    bool push(const string& payload) {
+        std::lock_guard<std::mutex> lock(mtx);
+        try {
+            if (write_fd < 0 || write_offset >= max_segment_bytes)
+                rotate();
+        } catch (const fc::exception& ex) {
+            elog ("data-plugin disk queue ${dir} : ${ex}", ("dir", dir.string())("ex", ex.to_string()));
+            return false;
+        }
+        char header[header_size];
+        uint32_t size = payload.size();
+        int64_t now = fc::time_point::now().time_since_epoch().count();
+        memcpy(header, &size, sizeof(size));
+        memcpy(header + sizeof(size), &now, sizeof(now));
+        string record(header, header_size);
+        record += payload;
+        if (!write_all(write_fd, record.data(), record.size())) {
+            elog ("data-plugin disk queue ${dir} : write failed. [errno=${errno}]", ("dir", dir.string())("errno", errno));
+            cut_tail();
+            return false;
+        }
+        if (policy == fsync_always && ::fsync(write_fd) != 0) {
+            elog ("data-plugin disk queue ${dir} : fsync failed. [errno=${errno}]", ("dir", dir.string())("errno", errno));
+            cut_tail();
+            return false;
+        }
+        write_offset += record.size();
+        count ++;
+        return true;
+    }
+
+    //read the oldest record without removing it
+    bool front(string& payload, fc::time_point& enqueue_time) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!load_front()) return false;
+        payload = front_payload;
+        enqueue_time = front_time;
+        return true;
+    }
+
+    void pop() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!load_front()) return;
+        read_offset += header_size + front_payload.size();
+        front_loaded = false;
+        front_payload.clear();
+        count --;
+        if (ahead_num > 0) ahead_num --;
+        else reset_ahead();
+        if (++pops_since_save >= cursor_save_interval || count == 0)
+            save_cursor();
+    }
+
+    //the records after the ones next already returned, starting at the front, so that a reader can
+    //have several of them in flight before it pops them. rewind starts over from the front
+    bool next(string& payload) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (ahead_num >= count) return false;
+        int64_t time_us;
+        while (true) {
+            if (ahead_fd < 0)
+                ahead_fd = ::open(segment_path(ahead_seq).c_str(), O_RDONLY);
+            if (ahead_fd >= 0 && read_record(ahead_fd, ahead_offset, payload, time_us)) {
+                ahead_offset += header_size + payload.size();
+                ahead_num ++;
+                return true;
+            }
+            if (ahead_seq >= write_seq) return false;
+            if (ahead_fd >= 0) {
+                ::close(ahead_fd);
+                ahead_fd = -1;
+            }
+            ahead_seq ++;
+            ahead_offset = 0;
+        }
+    }
+
+    void rewind() {
+        std::lock_guard<std::mutex> lock(mtx);
+        reset_ahead();
+    }
+
+    uint64_t size() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return count;
+    }
+
+    bool empty() {
+        return size() == 0;
+    }
+
+    //how long the oldest record has been waiting
+    fc::microseconds oldest_age() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!load_front()) return fc::microseconds(0);
+        return fc::time_point::now() - front_time;
+    }
+
+private:
+    static constexpr size_t header_size = sizeof(uint32_t) + sizeof(int64_t);
+    static constexpr uint32_t cursor_save_interval = 64;
+
+    boost::filesystem::path segment_path(uint64_t seq) const {
+        string name = std::to_string(seq);
+        return dir / (string(16 - std::min<size_t>(16, name.length()), '0') + name + ".seg");
+    }
+
+    static bool write_all(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            auto n = ::write(fd, data, len);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool read_all(int fd, char* data, size_t len, uint64_t offset) {
+        while (len > 0) {
+            auto n = ::pread(fd, data, len, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    static uint64_t file_size(int fd) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) return 0;
+        return st.st_size;
+    }
+
+    //close the write segment, if any, and go on with the next one
+    void rotate() {
+        if (write_fd >= 0) {
+            if (policy != fsync_none) ::fsync(write_fd);
+            ::close(write_fd);
+            write_fd = -1;
+            write_seq ++;
+        }
+        open_write_segment();
+    }
+
+    //drop what a failed push left after the last whole record. if the segment cannot be
+    //truncated it is closed, readers stop at its torn tail and go on with the next segment
+    void cut_tail() {
+        if (::ftruncate(write_fd, write_offset) == 0) return;
+        elog ("data-plugin disk queue ${dir} : truncate failed, start a new segment. [errno=${errno}]", ("dir", dir.string())("errno", errno));
+        ::close(write_fd);
+        write_fd = -1;
+        write_seq ++;
+    }
+
+    void open_write_segment() {
+        auto path = segment_path(write_seq);
+        write_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (write_fd < 0) {
+            FC_THROW_EXCEPTION(fc::file_not_found_exception, "data-plugin disk queue : open ${file} failed", ("file", path.string()));
+        }
+        write_offset = file_size(write_fd);
+    }
+
+    //count complete records of a segment from offset, cutting off a torn tail left by a crash
+    uint64_t scan_segment(uint64_t seq, uint64_t offset, bool truncate_tail) {
+        int fd = ::open(segment_path(seq).c_str(), truncate_tail ? O_RDWR : O_RDONLY);
+        if (fd < 0) return 0;
+        uint64_t total = file_size(fd);
+        uint64_t records = 0;
+        char header[header_size];
+        while (offset + header_size <= total && read_all(fd, header, header_size, offset)) {
+            uint32_t size;
+            memcpy(&size, header, sizeof(size));
+            if (offset + header_size + size > total) break;
+            offset += header_size + size;
+            records ++;
+        }
+        if (truncate_tail && offset < total) {
+            wlog ("data-plugin disk queue ${dir} : drop ${n} bytes of torn record", ("dir", dir.string())("n", total - offset));
+            if (::ftruncate(fd, offset) != 0)
+                elog ("data-plugin disk queue ${dir} : truncate failed", ("dir", dir.string()));
+        }
+        ::close(fd);
+        return records;
+    }
+
+    void reset_ahead() {
+        if (ahead_fd >= 0) {
+            ::close(ahead_fd);
+            ahead_fd = -1;
+        }
+        ahead_seq = read_seq;
+        ahead_offset = read_offset;
+        ahead_num = 0;
+    }
+
+    //the whole record at offset, false if the segment ends before it
+    static bool read_record(int fd, uint64_t offset, string& payload, int64_t& time_us) {
+        uint64_t total = file_size(fd);
+        char header[header_size];
+        if (offset + header_size > total || !read_all(fd, header, header_size, offset)) return false;
+        uint32_t size;
+        memcpy(&size, header, sizeof(size));
+        memcpy(&time_us, header + sizeof(size), sizeof(time_us));
+        if (offset + header_size + size > total) return false;
+        payload.resize(size);
+        return read_all(fd, &payload[0], size, offset + header_size);
+    }
+
+    bool load_front() {
+        if (front_loaded) return true;
+        if (count == 0) return false;
+        while (true) {
+            if (read_fd < 0)
+                read_fd = ::open(segment_path(read_seq).c_str(), O_RDONLY);
+            if (read_fd >= 0 && read_record(read_fd, read_offset, front_payload, front_time_us)) {
+                front_time = fc::time_point(fc::microseconds(front_time_us));
+                front_loaded = true;
+                return true;
+            }
+            if (read_seq >= write_seq) return false;
+            //current segment exhausted, move to the next one
+            if (read_fd >= 0) {
+                ::close(read_fd);
+                read_fd = -1;
+            }
+            boost::filesystem::remove(segment_path(read_seq));
+            read_seq ++;
+            read_offset = 0;
+            save_cursor();
+        }
+    }
+
+    void load_cursor() {
+        auto path = dir / "cursor";
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        char buf[64] = {0};
+        auto n = ::read(fd, buf, sizeof(buf) - 1);
+        ::close(fd);
+        unsigned long long seq, offset;
+        if (n > 0 && sscanf(buf, "%llu %llu", &seq, &offset) == 2 && seq >= read_seq) {
+            read_seq = seq;
+            read_offset = offset;
+        }
+    }
+
+    void save_cursor() {
+        pops_since_save = 0;
+        auto path = dir / "cursor";
+        auto tmp = dir / "cursor.tmp";
+        string content = std::to_string(read_seq) + " " + std::to_string(read_offset) + "\n";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || !write_all(fd, content.data(), content.size())) {
+            elog ("data-plugin disk queue ${dir} : save cursor failed", ("dir", dir.string()));
+            if (fd >= 0) ::close(fd);
+            return;
+        }
+        if (policy != fsync_none) ::fsync(fd);
+        ::close(fd);
+        ::rename(tmp.c_str(), path.c_str());
+    }
+
+    std::mutex mtx;
+    boost::filesystem::path dir;
+    uint64_t max_segment_bytes = 64 * 1024 * 1024;
+    fsync_policy policy = fsync_segment;
+
+    int write_fd = -1;
+    uint64_t write_seq = 0;
+    uint64_t write_offset = 0;
+
+    int read_fd = -1;
+    uint64_t read_seq = 0;
+    uint64_t read_offset = 0;
+    uint32_t pops_since_save = 0;
+
+    //where next reads, ahead_num records past the front
+    int ahead_fd = -1;
+    uint64_t ahead_seq = 0;
+    uint64_t ahead_offset = 0;
+    uint64_t ahead_num = 0;
+
+    uint64_t count = 0;
+    bool front_loaded = false;
+    string front_payload;
+    int64_t front_time_us = 0;
+    fc::time_point front_time;
+};
+
+}}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <fc/crypto/city.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+using std::vector;
+
+/**
+ * how many events of one struct are built, checked before the event is converted or built.
+ *
+ * sample keeps the fraction of the events whose id (trx id, block id) hashes under it, so
+ * all records of a transaction are kept or dropped together and every node keeps the same
+ * ones. rate is a token bucket of records per second holding at most burst records : an
+ * event is built while the bucket is not empty and its records are taken out afterwards,
+ * the bucket can go below 0 after a large event. the events turned away are counted, the
+ * records they would have had are estimated from the average of the built events.
+ *
+ * configured as sample=0.01;rate=500;burst=2000, burst is one second of rate by default.
+ */
+struct emission_limit {
+    explicit emission_limit(const string& spec) {
+        vector<string> items;
+        boost::split(items, spec, boost::is_any_of(";"));
+        for (auto& item : items) {
+            if (item.empty()) continue;
+            auto pos = item.find('=');
+            FC_ASSERT(pos != string::npos, "limit option should be name=value : ${i}", ("i", item));
+            auto name = item.substr(0, pos);
+            auto value = item.substr(pos + 1);
+            if (name == "sample") {
+                sample = std::stod(value);
+                FC_ASSERT(sample >= 0 && sample <= 1, "limit sample should be in [0, 1]");
+            } else if (name == "rate") {
+                rate = std::stod(value);
+                FC_ASSERT(rate > 0, "limit rate should be more than 0 records per second");
+            } else if (name == "burst") {
+                burst = std::stod(value);
+                FC_ASSERT(burst >= 1, "limit burst should be at least 1 record");
+            } else {
+                FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown limit option ${i}", ("i", item));
+            }
+        }
+        FC_ASSERT(sample < 1 || rate > 0, "limit without sample nor rate : ${s}", ("s", spec));
+        if (rate > 0 && burst < 1)
+            burst = std::max(1.0, rate);
+        threshold = sample >= 1 ? UINT64_MAX : uint64_t(sample * 18446744073709551616.0);
+        tokens = burst;
+    }
+
+    //if the event with this id is built
+    bool admit(const fc::sha256& id) {
+        if (sample < 1 && fc::city_hash64(id.data(), id.data_size()) >= threshold) {
+            sampled_out ++;
+            return false;
+        }
+        if (rate > 0) {
+            refill();
+            if (tokens <= 0) {
+                overflow ++;
+                if (overflow % report_every == 0)
+                    wlog ("data-plugin limit : ${n} events over the rate so far", ("n", overflow));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //the records the admitted event was built into
+    void consume(size_t n) {
+        events ++;
+        records += n;
+        if (rate > 0)
+            tokens -= double(n);
+    }
+
+    void report(const string& type_name) const {
+        if (!sampled_out && !overflow) return;
+        uint64_t average = events ? records / events : 0;
+        ilog ("data-plugin limit of ${t} : ${e} events built into ${r} records, ${s} sampled out, ${o} over the rate (about ${d} records dropped)",
+              ("t", type_name)("e", events)("r", records)("s", sampled_out)("o", overflow)("d", (sampled_out + overflow) * average));
+    }
+
+    double sample = 1;
+    double rate = 0;
+    double burst = 0;
+    uint64_t events = 0;
+    uint64_t records = 0;
+    uint64_t sampled_out = 0;
+    uint64_t overflow = 0;
+    uint64_t report_every = 10000;
+
+private:
+    void refill() {
+        auto now = std::chrono::steady_clock::now();
+        if (last != std::chrono::steady_clock::time_point())
+            tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - last).count());
+        last = now;
+    }
+
+    uint64_t threshold = UINT64_MAX;
+    double tokens = 0;
+    std::chrono::steady_clock::time_point last;
+};
+
+}}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <eosio/data_plugin/file_output.hpp>
+
+/**
+ * archive segment layout
+ *
+ *   "DPARCH01"
+ *   block*   [uint32 raw size][uint32 stored size][uint8 codec][stored bytes]
+ *   footer   fc::raw packed archive_footer
+ *   trailer  [uint64 footer offset]["DPARCH01"]
+ *
+ * a block is a run of fc::raw packed archive_records compressed as a whole. the footer indexes
+ * every block with its block_num range and every record by type name, so a reader decompresses
+ * only the blocks it needs. a segment cut short by a crash has no footer and is read by walking
+ * the block headers from the start.
+ */
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+using std::vector;
+
+constexpr char archive_magic[] = "DPARCH01";
+constexpr size_t archive_magic_size = sizeof(archive_magic) - 1;
+constexpr size_t archive_block_header_size = sizeof(uint32_t) * 2 + sizeof(uint8_t);
+
+struct archive_record {
+    string   name;
+    string   key;
+    string   json;
+    uint32_t block_num = 0;
+};
+
+struct archive_block_index {
+    uint64_t offset = 0;
+    uint32_t stored_size = 0;
+    uint32_t raw_size = 0;
+    uint32_t record_num = 0;
+    uint32_t first_block_num = 0;
+    uint32_t last_block_num = 0;
+};
+
+//a record inside an archive : the block it is in and its offset in the uncompressed block
+struct archive_record_ref {
+    uint32_t block = 0;
+    uint32_t offset = 0;
+};
+
+struct archive_footer {
+    vector<archive_block_index> blocks;
+    map<string, vector<archive_record_ref> > names;
+};
+
+}}
+
+FC_REFLECT(eosio::data::archive_record, (name)(key)(json)(block_num))
+FC_REFLECT(eosio::data::archive_block_index, (offset)(stored_size)(raw_size)(record_num)(first_block_num)(last_block_num))
+FC_REFLECT(eosio::data::archive_record_ref, (block)(offset))
+FC_REFLECT(eosio::data::archive_footer, (blocks)(names))
+
+namespace eosio{ namespace data{
+
+//the block number a record belongs to, 0 if the record does not tell
+inline uint32_t record_block_num(const fc::variant& value) {
+    if (!value.is_object()) return 0;
+    auto& obj = value.get_object();
+    for (auto field : {"block_num", "block_num_askey", "info:block_num"}) {
+        auto it = obj.find(field);
+        if (it != obj.end() && it->value().is_numeric())
+            return it->value().as_uint64();
+    }
+    return 0;
+}
+
+struct archive_output : file_output {
+    explicit archive_output(const file_output_config& c) : conf(c), block_compressor(c.compression_level) {
+        stream.buffer_size = conf.buffer_size;
+        stream.policy = conf.fsync;
+        stream.async_io = conf.backend == file_output_config::backend_uring;
+        stream.uring_buffers = conf.uring_buffers;
+        raw.reserve(conf.block_size + 64 * 1024);
+    }
+
+    void write(const file_record& record, time_t now) {
+        if (clock.tick(now)) {
+            close();
+            seq = 0;
+        }
+        if (!stream.is_open())
+            open_segment();
+        archive_record ar;
+        ar.name = record.name;
+        ar.key = record.key;
+        ar.json = fc::json::to_string(record.value, fc::json::legacy_generator);
+        ar.block_num = record_block_num(record.value);
+
+        footer.names[ar.name].push_back({uint32_t(footer.blocks.size()), uint32_t(raw.size())});
+        auto packed = fc::raw::pack(ar);
+        raw.append(packed.data(), packed.size());
+        current.record_num ++;
+        if (ar.block_num) {
+            if (!current.first_block_num || ar.block_num < current.first_block_num)
+                current.first_block_num = ar.block_num;
+            if (ar.block_num > current.last_block_num)
+                current.last_block_num = ar.block_num;
+        }
+        if (raw.size() >= conf.block_size)
+            write_block();
+        if (segment_offset >= conf.segment_size)
+            close();
+    }
+
+    //blocks are only cut by size so that they compress well, flush just hands the cut ones to the file
+    bool flush() {
+        return stream.flush();
+    }
+
+    //the records of the block not cut yet, they are confirmed once it is written
+    uint64_t held() const {
+        return current.record_num;
+    }
+
+    //finish the segment with its footer, the next record opens a new one
+    bool close() {
+        if (!stream.is_open()) return !stream.lost;
+        write_block();
+        auto packed = fc::raw::pack(footer);
+        uint64_t footer_offset = segment_offset;
+        stream.append(packed.data(), packed.size());
+        stream.append((const char*)&footer_offset, sizeof(footer_offset));
+        stream.append(archive_magic, archive_magic_size);
+        bool ok = stream.close();
+        footer = archive_footer();
+        seq ++;
+        return ok;
+    }
+
+private:
+    void open_segment() {
+        //a restart within the same hour goes on with the next free sequence number
+        string file_name = segment_name();
+        while (boost::filesystem::exists(file_name)) {
+            seq ++;
+            file_name = segment_name();
+        }
+        stream.open(file_name);
+        stream.append(archive_magic, archive_magic_size);
+        segment_offset = archive_magic_size;
+    }
+
+    string segment_name() const {
+        string num = std::to_string(seq);
+        return conf.path.string() + "." + clock.hour + "." + string(4 - std::min<size_t>(4, num.length()), '0') + num + ".dpa";
+    }
+
+    void write_block() {
+        if (raw.empty()) return;
+        block_compressor.compress(conf.codec, raw, stored);
+        uint32_t raw_size = raw.size();
+        uint32_t stored_size = stored.size();
+        uint8_t codec = conf.codec;
+        current.offset = segment_offset;
+        current.raw_size = raw_size;
+        current.stored_size = stored_size;
+        footer.blocks.push_back(current);
+        stream.append((const char*)&raw_size, sizeof(raw_size));
+        stream.append((const char*)&stored_size, sizeof(stored_size));
+        stream.append((const char*)&codec, sizeof(codec));
+        stream.append(stored.data(), stored.size());
+        segment_offset += archive_block_header_size + stored.size();
+        raw.clear();
+        current = archive_block_index();
+    }
+
+    file_output_config conf;
+    hour_clock clock;
+    file_stream stream;
+    compressor block_compressor;
+    uint32_t seq = 0;
+    uint64_t segment_offset = 0;
+    string raw;
+    string stored;
+    archive_block_index current;
+    archive_footer footer;
+};
+
+/**
+ * read access to one archive segment through a read only memory mapping
+ */
+struct archive_reader {
+    ~archive_reader() {
+        close();
+    }
+
+    void open(const string& file_name) {
+        close();
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        FC_ASSERT(fd >= 0, "open archive ${f} failed", ("f", file_name));
+        struct stat st;
+        ::fstat(fd, &st);
+        size = st.st_size;
+        if (size > 0) {
+            data = (const char*)::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) data = nullptr;
+        }
+        ::close(fd);
+        FC_ASSERT(data && size >= archive_magic_size && memcmp(data, archive_magic, archive_magic_size) == 0,
+                  "${f} is not a data plugin archive", ("f", file_name));
+        if (!load_footer()) {
+            wlog ("data-plugin archive ${f} has no footer, rebuild the index from the blocks", ("f", file_name));
+            rebuild_footer();
+        }
+    }
+
+    void close() {
+        if (data) ::munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+        footer = archive_footer();
+    }
+
+    const archive_footer& index() const {
+        return footer;
+    }
+
+    //decompress one block and return its records
+    vector<archive_record> read_block(uint32_t block) {
+        string raw;
+        read_raw_block(block, raw);
+        vector<archive_record> records;
+        records.reserve(footer.blocks[block].record_num);
+        fc::datastream<const char*> ds(raw.data(), raw.size());
+        while (ds.remaining()) {
+            archive_record record;
+            fc::raw::unpack(ds, record);
+            records.push_back(std::move(record));
+        }
+        return records;
+    }
+
+    //the blocks holding records of block numbers in [from, to]
+    vector<uint32_t> blocks_in_range(uint32_t from, uint32_t to) const {
+        vector<uint32_t> res;
+        for (uint32_t i = 0; i < footer.blocks.size(); i ++) {
+            auto& b = footer.blocks[i];
+            if (!b.first_block_num || (b.last_block_num >= from && b.first_block_num <= to))
+                res.push_back(i);
+        }
+        return res;
+    }
+
+    //the records of one type name, decompressing only the blocks which contain them
+    vector<archive_record> read_name(const string& name) {
+        vector<archive_record> records;
+        auto it = footer.names.find(name);
+        if (it == footer.names.end()) return records;
+        string raw;
+        int64_t loaded = -1;
+        for (auto& ref : it->second) {
+            if (loaded != ref.block) {
+                read_raw_block(ref.block, raw);
+                loaded = ref.block;
+            }
+            fc::datastream<const char*> ds(raw.data() + ref.offset, raw.size() - ref.offset);
+            archive_record record;
+            fc::raw::unpack(ds, record);
+            records.push_back(std::move(record));
+        }
+        return records;
+    }
+
+private:
+    void read_raw_block(uint32_t block, string& raw) {
+        FC_ASSERT(block < footer.blocks.size(), "block ${b} out of range", ("b", block));
+        auto& b = footer.blocks[block];
+        FC_ASSERT(b.offset + archive_block_header_size + b.stored_size <= size, "block ${b} truncated", ("b", block));
+        uint8_t codec = data[b.offset + sizeof(uint32_t) * 2];
+        block_compressor.decompress(compressor::codec(codec), data + b.offset + archive_block_header_size, b.stored_size, raw);
+    }
+
+    bool load_footer() {
+        if (size < archive_magic_size * 2 + sizeof(uint64_t)) return false;
+        if (memcmp(data + size - archive_magic_size, archive_magic, archive_magic_size) != 0) return false;
+        uint64_t footer_offset;
+        memcpy(&footer_offset, data + size - archive_magic_size - sizeof(uint64_t), sizeof(footer_offset));
+        if (footer_offset >= size) return false;
+        try {
+            fc::datastream<const char*> ds(data + footer_offset, size - archive_magic_size - sizeof(uint64_t) - footer_offset);
+            fc::raw::unpack(ds, footer);
+            return true;
+        } catch (const fc::exception& ex) {
+            return false;
+        }
+    }
+
+    void rebuild_footer() {
+        footer = archive_footer();
+        uint64_t offset = archive_magic_size;
+        while (offset + archive_block_header_size <= size) {
+            archive_block_index b;
+            memcpy(&b.raw_size, data + offset, sizeof(uint32_t));
+            memcpy(&b.stored_size, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+            if (offset + archive_block_header_size + b.stored_size > size) break;
+            b.offset = offset;
+            footer.blocks.push_back(b);
+            uint32_t block = footer.blocks.size() - 1;
+            vector<archive_record> records;
+            try {
+                records = read_block(block);
+            } catch (const fc::exception& ex) {
+                footer.blocks.pop_back();
+                break;
+            }
+            auto& index = footer.blocks.back();
+            uint32_t record_offset = 0;
+            for (auto& record : records) {
+                footer.names[record.name].push_back({block, record_offset});
+                record_offset += fc::raw::pack_size(record);
+                index.record_num ++;
+                if (record.block_num) {
+                    if (!index.first_block_num || record.block_num < index.first_block_num)
+                        index.first_block_num = record.block_num;
+                    if (record.block_num > index.last_block_num)
+                        index.last_block_num = record.block_num;
+                }
+            }
+            offset += archive_block_header_size + b.stored_size;
+        }
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+    archive_footer footer;
+    compressor block_compressor;
+};
+
+}}
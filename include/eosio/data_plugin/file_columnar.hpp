@@ -0,0 +1,371 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fc/io/raw.hpp>
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <eosio/chain/name.hpp>
+#include <eosio/data_plugin/file_output.hpp>
+
+/**
+ * columnar segment layout, one struct name per file
+ *
+ *   "DPCOLU01"
+ *   row group*  one compressed chunk per column, in schema order
+ *   footer      fc::raw packed columnar_footer : the schema and the offset of every chunk
+ *   trailer     [uint64 footer offset]["DPCOLU01"]
+ *
+ * a chunk holds the values of one column for the rows of one row group :
+ *   int64, timestamp (ms since epoch), double : the values one after another
+ *   string                                    : fc::raw packed vector<string>
+ *   name, dict string                         : fc::raw packed dictionary, then a uint32 index per row
+ * a reader only decompresses the chunks of the columns it asks for.
+ */
+namespace eosio{ namespace data{
+
+using std::string;
+using std::vector;
+
+constexpr char columnar_magic[] = "DPCOLU01";
+constexpr size_t columnar_magic_size = sizeof(columnar_magic) - 1;
+
+struct columnar_column {
+    enum column_type : uint8_t {
+        col_int64       = 0,
+        col_timestamp   = 1,
+        col_double      = 2,
+        col_name        = 3,    //eosio name as uint64, dictionary encoded
+        col_string      = 4,
+        col_dict_string = 5,    //strings with few distinct values, dictionary encoded
+    };
+
+    string  name;
+    uint8_t type = col_int64;
+};
+
+struct columnar_chunk {
+    uint64_t offset = 0;
+    uint32_t stored_size = 0;
+    uint32_t raw_size = 0;
+    uint8_t  codec = 0;
+};
+
+struct columnar_row_group {
+    uint32_t row_num = 0;
+    int64_t  min_timestamp = 0;
+    int64_t  max_timestamp = 0;
+    vector<columnar_chunk> chunks;
+};
+
+struct columnar_footer {
+    string table;
+    vector<columnar_column> columns;
+    vector<columnar_row_group> row_groups;
+};
+
+}}
+
+FC_REFLECT(eosio::data::columnar_column, (name)(type))
+FC_REFLECT(eosio::data::columnar_chunk, (offset)(stored_size)(raw_size)(codec))
+FC_REFLECT(eosio::data::columnar_row_group, (row_num)(min_timestamp)(max_timestamp)(chunks))
+FC_REFLECT(eosio::data::columnar_footer, (table)(columns)(row_groups))
+
+namespace eosio{ namespace data{
+
+struct columnar_schema {
+    string suffix;
+    vector<columnar_column> columns;
+};
+
+//the flat analytics structs written column by column, matched on the end of their destination name
+inline const vector<columnar_schema>& columnar_schemas() {
+    typedef columnar_column c;
+    static const vector<columnar_schema> schemas = {
+        {"druid.transfer", {
+            {"transaction_id", c::col_string},
+            {"block_num",      c::col_int64},
+            {"block_time",     c::col_timestamp},
+            {"from",           c::col_name},
+            {"to",             c::col_name},
+            {"memo",           c::col_dict_string},
+            {"symbol",         c::col_dict_string},
+            {"amount",         c::col_double},
+        }},
+        {"druid.resource", {
+            {"block_time",      c::col_timestamp},
+            {"trx",             c::col_string},
+            {"cpu_usage_us",    c::col_int64},
+            {"net_usage_words", c::col_int64},
+            {"actor",           c::col_name},
+            {"receiver",        c::col_name},
+        }},
+        {"druid.active", {
+            {"block_time", c::col_timestamp},
+            {"trx",        c::col_string},
+            {"actor",      c::col_name},
+            {"receiver",   c::col_name},
+            {"method",     c::col_dict_string},
+        }},
+    };
+    return schemas;
+}
+
+inline const columnar_schema* find_columnar_schema(const string& name) {
+    for (auto& schema : columnar_schemas()) {
+        if (name == schema.suffix) return &schema;
+        if (name.size() > schema.suffix.size()
+            && name[name.size() - schema.suffix.size() - 1] == '.'
+            && name.compare(name.size() - schema.suffix.size(), schema.suffix.size(), schema.suffix) == 0)
+            return &schema;
+    }
+    return nullptr;
+}
+
+/**
+ * the values of one column for the rows of the current row group
+ */
+struct columnar_builder {
+    explicit columnar_builder(const columnar_column& c) : column(c) {}
+
+    //one value converted to the column type, apart so that a row is only appended once all of it converts
+    struct value_type {
+        int64_t  number = 0;
+        double   real = 0;
+        uint64_t name = 0;
+        string   text;
+    };
+
+    //throws if the value does not fit the column
+    void convert(const fc::variant& value, value_type& out) const {
+        switch (column.type) {
+            case columnar_column::col_int64:
+                out.number = value.is_numeric() ? value.as_int64() : (value.is_null() ? 0 : std::stoll(value.as_string()));
+                break;
+            case columnar_column::col_timestamp:
+                out.number = value.is_null() ? 0 : fc::time_point::from_iso_string(value.as_string()).time_since_epoch().count() / 1000;
+                break;
+            case columnar_column::col_double:
+                out.real = value.is_null() ? 0 : value.as_double();
+                break;
+            case columnar_column::col_name:
+                out.name = value.is_null() ? 0 : chain::name(value.as_string()).value;
+                break;
+            case columnar_column::col_string:
+            case columnar_column::col_dict_string:
+                out.text = value.is_null() ? string() : value.as_string();
+                break;
+        }
+    }
+
+    //return the timestamp for timestamp columns, 0 otherwise
+    int64_t append(value_type& value) {
+        switch (column.type) {
+            case columnar_column::col_int64:
+                numbers.push_back(value.number);
+                return 0;
+            case columnar_column::col_timestamp:
+                numbers.push_back(value.number);
+                return value.number;
+            case columnar_column::col_double:
+                doubles.push_back(value.real);
+                return 0;
+            case columnar_column::col_name: {
+                auto it = name_dict.find(value.name);
+                if (it == name_dict.end()) {
+                    it = name_dict.emplace(value.name, name_values.size()).first;
+                    name_values.push_back(value.name);
+                }
+                indices.push_back(it->second);
+                return 0;
+            }
+            case columnar_column::col_string:
+                strings.push_back(std::move(value.text));
+                return 0;
+            case columnar_column::col_dict_string: {
+                auto it = string_dict.find(value.text);
+                if (it == string_dict.end()) {
+                    it = string_dict.emplace(value.text, strings.size()).first;
+                    strings.push_back(std::move(value.text));
+                }
+                indices.push_back(it->second);
+                return 0;
+            }
+        }
+        return 0;
+    }
+
+    void encode(string& out) const {
+        out.clear();
+        switch (column.type) {
+            case columnar_column::col_int64:
+            case columnar_column::col_timestamp:
+                out.assign((const char*)numbers.data(), numbers.size() * sizeof(int64_t));
+                break;
+            case columnar_column::col_double:
+                out.assign((const char*)doubles.data(), doubles.size() * sizeof(double));
+                break;
+            case columnar_column::col_string: {
+                auto packed = fc::raw::pack(strings);
+                out.assign(packed.data(), packed.size());
+                break;
+            }
+            case columnar_column::col_name: {
+                auto packed = fc::raw::pack(name_values);
+                out.assign(packed.data(), packed.size());
+                out.append((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+                break;
+            }
+            case columnar_column::col_dict_string: {
+                auto packed = fc::raw::pack(strings);
+                out.assign(packed.data(), packed.size());
+                out.append((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+                break;
+            }
+        }
+    }
+
+    void clear() {
+        numbers.clear();
+        doubles.clear();
+        strings.clear();
+        indices.clear();
+        name_values.clear();
+        name_dict.clear();
+        string_dict.clear();
+    }
+
+    columnar_column column;
+    vector<int64_t> numbers;
+    vector<double> doubles;
+    vector<string> strings;
+    vector<uint32_t> indices;
+    vector<uint64_t> name_values;
+    std::unordered_map<uint64_t, uint32_t> name_dict;
+    std::unordered_map<string, uint32_t> string_dict;
+};
+
+/**
+ * writes the records of one struct name into row groups, rotated every hour and by size
+ */
+struct columnar_output : file_output {
+    columnar_output(const file_output_config& c, const string& table, const columnar_schema& schema)
+        : conf(c), chunk_compressor(c.compression_level) {
+        stream.buffer_size = conf.buffer_size;
+        stream.policy = conf.fsync;
+        stream.async_io = conf.backend == file_output_config::backend_uring;
+        stream.uring_buffers = conf.uring_buffers;
+        footer.table = table;
+        footer.columns = schema.columns;
+        for (auto& column : schema.columns)
+            builders.emplace_back(column);
+    }
+
+    void write(const file_record& record, time_t now) {
+        if (clock.tick(now)) {
+            close();
+            seq = 0;
+        }
+        if (!stream.is_open())
+            open_segment();
+        if (!record.value.is_object()) return;
+        auto& obj = record.value.get_object();
+        //a value which does not convert throws here, before any column got the row
+        row.resize(builders.size());
+        for (size_t i = 0; i < builders.size(); i ++) {
+            auto it = obj.find(builders[i].column.name);
+            builders[i].convert(it == obj.end() ? fc::variant() : it->value(), row[i]);
+        }
+        for (size_t i = 0; i < builders.size(); i ++) {
+            auto& builder = builders[i];
+            auto ts = builder.append(row[i]);
+            if (builder.column.type == columnar_column::col_timestamp) {
+                if (!rows || ts < current.min_timestamp) current.min_timestamp = ts;
+                if (!rows || ts > current.max_timestamp) current.max_timestamp = ts;
+            }
+        }
+        rows ++;
+        if (rows >= conf.row_group_rows)
+            write_row_group();
+        if (segment_offset >= conf.segment_size)
+            close();
+    }
+
+    //row groups are only cut by size so that they stay large, flush just hands the written ones to the file
+    bool flush() {
+        return stream.flush();
+    }
+
+    uint64_t held() const {
+        return rows;
+    }
+
+    bool close() {
+        if (!stream.is_open()) return !stream.lost;
+        write_row_group();
+        auto packed = fc::raw::pack(footer);
+        uint64_t footer_offset = segment_offset;
+        stream.append(packed.data(), packed.size());
+        stream.append((const char*)&footer_offset, sizeof(footer_offset));
+        stream.append(columnar_magic, columnar_magic_size);
+        bool ok = stream.close();
+        footer.row_groups.clear();
+        seq ++;
+        return ok;
+    }
+
+private:
+    void open_segment() {
+        string file_name = segment_name();
+        while (boost::filesystem::exists(file_name)) {
+            seq ++;
+            file_name = segment_name();
+        }
+        stream.open(file_name);
+        stream.append(columnar_magic, columnar_magic_size);
+        segment_offset = columnar_magic_size;
+    }
+
+    string segment_name() const {
+        string num = std::to_string(seq);
+        return conf.path.string() + "." + clock.hour + "." + string(4 - std::min<size_t>(4, num.length()), '0') + num + ".dpc";
+    }
+
+    void write_row_group() {
+        if (rows == 0) return;
+        current.row_num = rows;
+        for (auto& builder : builders) {
+            builder.encode(raw);
+            chunk_compressor.compress(conf.codec, raw, stored);
+            columnar_chunk chunk;
+            chunk.offset = segment_offset;
+            chunk.raw_size = raw.size();
+            chunk.stored_size = stored.size();
+            chunk.codec = conf.codec;
+            current.chunks.push_back(chunk);
+            stream.append(stored.data(), stored.size());
+            segment_offset += stored.size();
+            builder.clear();
+        }
+        footer.row_groups.push_back(current);
+        current = columnar_row_group();
+        rows = 0;
+    }
+
+    file_output_config conf;
+    hour_clock clock;
+    file_stream stream;
+    compressor chunk_compressor;
+    uint32_t seq = 0;
+    uint64_t segment_offset = 0;
+    uint32_t rows = 0;
+    string raw;
+    string stored;
+    vector<columnar_builder> builders;
+    vector<columnar_builder::value_type> row;
+    columnar_row_group current;
+    columnar_footer footer;
+};
+
+}}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/filesystem.hpp>
+#include <eosio/data_plugin/compressor.hpp>
+#include <eosio/data_plugin/file_uring.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+struct file_record {
+    string name;
+    string key;
+    fc::variant value;
+    //not a record but the mark of this block, see file_writer::mark
+    uint32_t mark = 0;
+};
+
+/**
+ * local time in hours, localtime() is only called again once the cached hour is over
+ */
+struct hour_clock {
+    //return true if the hour changed since the last call
+    bool tick(time_t now) {
+        if (now < next_hour) return false;
+        tm t;
+        localtime_r(&now, &t);
+        char now_str[16];
+        strftime(now_str, sizeof(now_str), "%Y%m%d%H", &t);
+        hour = now_str;
+        next_hour = now - t.tm_min * 60 - t.tm_sec + 3600;
+        return true;
+    }
+
+    string hour;
+    time_t next_hour = 0;
+};
+
+/**
+ * one output file written through a user space buffer.
+ * with async_io the buffer is handed to io_uring instead of write(), see file_uring.hpp;
+ * without io_uring support the stream stays on write().
+ *
+ * flush returns true once everything appended is in the file, fsynced with fsync_flush; with
+ * io_uring it waits for the writes and the sync to complete. bytes which cannot be written
+ * stay in the buffer for the next flush, up to a few buffers. past that, or when a file is
+ * closed with bytes left, the bytes are dropped and the stream is lost : flush never returns
+ * true again, so nothing written after the drop is taken as in the file.
+ */
+struct file_stream {
+    enum fsync_policy {
+        fsync_none,     //leave it to the page cache
+        fsync_rotate,   //fsync when a file is rotated or closed
+        fsync_flush     //fsync after every flush
+    };
+
+    static fsync_policy parse_fsync_policy(const string& policy) {
+        if (policy == "none")   return fsync_none;
+        if (policy == "rotate") return fsync_rotate;
+        if (policy == "flush")  return fsync_flush;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown fsync policy ${p}, expect none/rotate/flush", ("p", policy));
+    }
+
+    ~file_stream() {
+        close();
+    }
+
+    bool is_open() const {
+        return fd >= 0 || !file_name.empty();
+    }
+
+    void open(const string& name) {
+        close();
+        file_name = name;
+#ifdef DATA_PLUGIN_HAVE_URING
+        if (async_io && !ring) {
+            ring = std::make_unique<uring_writer>();
+            if (!ring->init(buffer_size, uring_buffers)) {
+                wlog ("data-plugin file producer : io_uring is not available, use buffered writes");
+                ring.reset();
+                async_io = false;
+            }
+        }
+#endif
+        open_fd();
+    }
+
+    //false if bytes of the file were lost
+    bool close() {
+        if (!is_open()) return !lost;
+#ifdef DATA_PLUGIN_HAVE_URING
+        if (ring) {
+            if (fd >= 0)
+                ring->submit(fd, offset);
+            ring->wait_all();
+            if (ring->failed)
+                lost = true;
+        } else
+#endif
+        if (!flush() && !buffer.empty())
+            drop("the file is closed");
+        if (fd >= 0) {
+            if (policy != fsync_none && ::fdatasync(fd) != 0) {
+                elog ("data-plugin file producer : fdatasync ${file} failed. [errno=${errno}]", ("file", file_name)("errno", errno));
+                lost = true;
+            }
+            ::close(fd);
+        }
+        fd = -1;
+        file_name.clear();
+        return !lost;
+    }
+
+    void append(const char* data, size_t len) {
+#ifdef DATA_PLUGIN_HAVE_URING
+        if (ring) {
+            if (fd >= 0)
+                ring->append(fd, offset, data, len);
+            else if (!lost)
+                drop("the file is not open");
+            return;
+        }
+#endif
+        buffer.append(data, len);
+        if (buffer.size() < buffer_size) return;
+        //after a failed write the next try waits for the flush interval
+        if (retrying)
+            keep();
+        else
+            flush();
+    }
+
+    bool flush() {
+#ifdef DATA_PLUGIN_HAVE_URING
+        if (ring) {
+            if (fd < 0) return false;
+            ring->submit(fd, offset);
+            if (policy == fsync_flush)
+                ring->sync(fd);
+            ring->wait_all();
+            if (ring->failed && !lost) {
+                elog ("data-plugin file producer : io_uring write to ${file} failed, records are lost", ("file", file_name));
+                lost = true;
+            }
+            return !lost;
+        }
+#endif
+        if (buffer.empty()) return !lost;
+        if (fd < 0 && !file_name.empty())
+            open_fd();
+        if (fd < 0)
+            return keep();
+        size_t written = 0;
+        while (written < buffer.size()) {
+            auto n = ::write(fd, buffer.data() + written, buffer.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                elog ("data-plugin file producer : write ${file} failed, retry on the next flush. [errno=${errno}]", ("file", file_name)("errno", errno));
+                buffer.erase(0, written);
+                return keep();
+            }
+            written += n;
+        }
+        buffer.clear();
+        retrying = false;
+        if (policy == fsync_flush && ::fdatasync(fd) != 0) {
+            elog ("data-plugin file producer : fdatasync ${file} failed, records are lost. [errno=${errno}]", ("file", file_name)("errno", errno));
+            lost = true;
+        }
+        return !lost;
+    }
+
+    int fd = -1;
+    string file_name;
+    string buffer;
+    size_t buffer_size = 4 * 1024 * 1024;
+    fsync_policy policy = fsync_none;
+    bool async_io = false;
+    unsigned uring_buffers = 4;
+    //bytes were dropped, the file misses records for good
+    bool lost = false;
+    bool retrying = false;
+#ifdef DATA_PLUGIN_HAVE_URING
+    std::unique_ptr<uring_writer> ring;
+    uint64_t offset = 0;
+#endif
+
+private:
+    void open_fd() {
+#ifdef DATA_PLUGIN_HAVE_URING
+        if (ring) {
+            //writes go to explicit offsets, they may complete out of order
+            fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT, 0644);
+            if (fd >= 0) offset = ::lseek(fd, 0, SEEK_END);
+        } else
+#endif
+        fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+            wlog ("data-plugin file producer : open file ${file} failed. [errno=${errno}]", ("file", file_name)("errno", errno));
+    }
+
+    //the bytes not written wait for the next flush while they fit in a few buffers
+    bool keep() {
+        retrying = true;
+        if (buffer.size() > 4 * buffer_size)
+            drop("the write buffer is full");
+        return false;
+    }
+
+    void drop(const char* reason) {
+        if (!lost)
+            elog ("data-plugin file producer : ${n} bytes of ${file} dropped, ${r}. the checkpoint stays before them until restart",
+                  ("n", buffer.size())("file", file_name)("r", reason));
+        buffer.clear();
+        lost = true;
+    }
+};
+
+struct file_output_config {
+    enum output_format {
+        text,       //name \t key \t json lines, rotated every hour
+        archive,    //compressed segments with an index, see file_archive.hpp
+        columnar    //one file per struct name written by column, see file_columnar.hpp
+    };
+
+    enum io_backend {
+        backend_buffered,   //write() from the writer thread
+        backend_uring       //io_uring, falls back to write() when not available
+    };
+
+    static io_backend parse_io_backend(const string& backend) {
+        if (backend == "buffered") return backend_buffered;
+        if (backend == "io_uring") return backend_uring;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown io backend ${b}, expect buffered/io_uring", ("b", backend));
+    }
+
+    static output_format parse_format(const string& format) {
+        if (format == "text")     return text;
+        if (format == "archive")  return archive;
+        if (format == "columnar") return columnar;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown file format ${f}, expect text/archive/columnar", ("f", format));
+    }
+
+    boost::filesystem::path path;
+    output_format format = text;
+    size_t buffer_size = 4 * 1024 * 1024;
+    file_stream::fsync_policy fsync = file_stream::fsync_none;
+    uint64_t segment_size = 1024ull * 1024 * 1024;
+    size_t block_size = 1024 * 1024;
+    compressor::codec codec = compressor::gzip;
+    int compression_level = 0;
+    uint32_t row_group_rows = 100000;
+    io_backend backend = backend_buffered;
+    unsigned uring_buffers = 4;
+};
+
+/**
+ * the on disk format of FileProducer, only used by the writer thread
+ */
+struct file_output {
+    virtual ~file_output() {}
+    virtual void write(const file_record& record, time_t now) = 0;
+    //called on the flush interval, true once the records written are in the file
+    virtual bool flush() = 0;
+    //false if records of the file were lost
+    virtual bool close() = 0;
+    //the records written which a flush does not hand to the file, like an open row group
+    virtual uint64_t held() const {
+        return 0;
+    }
+
+    //kept by the writer thread : records written, and those in the file as of the last flush
+    uint64_t written = 0;
+    uint64_t flushed = 0;
+};
+
+/**
+ * the key field of a text line. binary keys can hold any byte, a tab, a newline and a
+ * backslash are written as \t, \n and \\ so the line keeps its three fields. legacy and
+ * text keys are hex and never change.
+ */
+struct text_key {
+    static string escape(const string& key) {
+        if (key.find_first_of("\t\n\\") == string::npos) return key;
+        string res;
+        res.reserve(key.size() + 8);
+        for (char c : key) {
+            if (c == '\t')       res += "\\t";
+            else if (c == '\n')  res += "\\n";
+            else if (c == '\\')  res += "\\\\";
+            else                 res += c;
+        }
+        return res;
+    }
+
+    static string unescape(const char* begin, const char* end) {
+        if (std::find(begin, end, '\\') == end) return string(begin, end);
+        string res;
+        res.reserve(end - begin);
+        for (const char* p = begin; p < end; p ++) {
+            if (*p != '\\' || p + 1 == end) {
+                res += *p;
+                continue;
+            }
+            p ++;
+            res += *p == 't' ? '\t' : *p == 'n' ? '\n' : *p;
+        }
+        return res;
+    }
+};
+
+struct text_output : file_output {
+    explicit text_output(const file_output_config& c) : conf(c) {
+        stream.buffer_size = conf.buffer_size;
+        stream.policy = conf.fsync;
+        stream.async_io = conf.backend == file_output_config::backend_uring;
+        stream.uring_buffers = conf.uring_buffers;
+        if (!stream.async_io)
+            stream.buffer.reserve(conf.buffer_size + 64 * 1024);
+    }
+
+    void write(const file_record& record, time_t now) {
+        if (clock.tick(now))
+            stream.open(conf.path.string() + "." + clock.hour);
+        string line;
+        line.reserve(record.name.size() + record.key.size() + 512);
+        line += record.name;
+        line += '\t';
+        line += text_key::escape(record.key);
+        line += '\t';
+        line += fc::json::to_string(record.value, fc::json::legacy_generator);
+        line += '\n';
+        stream.append(line.data(), line.size());
+    }
+
+    bool flush() {
+        return stream.flush();
+    }
+
+    bool close() {
+        return stream.close();
+    }
+
+    file_output_config conf;
+    hour_clock clock;
+    file_stream stream;
+};
+
+}}
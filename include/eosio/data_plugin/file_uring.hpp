@@ -0,0 +1,215 @@
+#pragma once
+
+#ifdef DATA_PLUGIN_HAVE_URING
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <liburing.h>
+#include <fc/log/logger.hpp>
+
+namespace eosio{ namespace data{
+
+using std::vector;
+
+/**
+ * asynchronous writes of one file through io_uring.
+ *
+ * the caller fills one of a few fixed buffers, registered with the kernel when the memlock
+ * limit allows it; a full buffer is submitted as one write at its file offset and the caller
+ * goes on with the next free buffer. fdatasync is queued behind the writes with IO_DRAIN,
+ * so neither writes nor syncs block the writer thread unless every buffer is in flight or
+ * the caller waits for them, as file_stream does on flush to know they are in the file.
+ */
+struct uring_writer {
+    ~uring_writer() {
+        if (!ready) return;
+        wait_all();
+        if (registered)
+            io_uring_unregister_buffers(&ring);
+        io_uring_queue_exit(&ring);
+        for (auto& b : buffers)
+            free(b.data);
+    }
+
+    bool init(size_t size, unsigned num) {
+        if (io_uring_queue_init(num * 2, &ring, 0) < 0)
+            return false;
+        ready = true;
+        buffer_size = size;
+        buffers.resize(num);
+        vector<iovec> iovecs(num);
+        for (unsigned i = 0; i < num; i ++) {
+            if (posix_memalign((void**)&buffers[i].data, 4096, size) != 0) {
+                buffers.resize(i);
+                return false;
+            }
+            iovecs[i].iov_base = buffers[i].data;
+            iovecs[i].iov_len = size;
+            free_buffers.push_back(i);
+        }
+        registered = io_uring_register_buffers(&ring, iovecs.data(), num) == 0;
+        if (!registered)
+            wlog ("data-plugin file producer : io_uring buffers not registered, check the memlock limit");
+        current = acquire();
+        return true;
+    }
+
+    //copy into the current buffer, submitting every buffer which gets full
+    void append(int fd, uint64_t& offset, const char* data, size_t len) {
+        while (len > 0) {
+            auto& b = buffers[current];
+            size_t n = std::min(len, buffer_size - b.used);
+            memcpy(b.data + b.used, data, n);
+            b.used += n;
+            data += n;
+            len -= n;
+            if (b.used == buffer_size)
+                submit(fd, offset);
+        }
+    }
+
+    //hand the partially filled buffer to the kernel
+    void submit(int fd, uint64_t& offset) {
+        auto& b = buffers[current];
+        if (b.used == 0) return;
+        b.offset = offset;
+        offset += b.used;
+        auto sqe = get_sqe();
+        if (registered)
+            io_uring_prep_write_fixed(sqe, fd, b.data, b.used, b.offset, current);
+        else
+            io_uring_prep_write(sqe, fd, b.data, b.used, b.offset);
+        io_uring_sqe_set_data(sqe, (void*)uintptr_t(current));
+        b.fd = fd;
+        b.busy = true;
+        io_uring_submit(&ring);
+        inflight ++;
+        //take what is done already so that buffers come back without waiting
+        reap(false);
+        current = acquire();
+    }
+
+    //an fdatasync which starts once every write submitted before it is done
+    void sync(int fd) {
+        auto sqe = get_sqe();
+        io_uring_prep_fsync(sqe, fd, IORING_FSYNC_DATASYNC);
+        sqe->flags |= IOSQE_IO_DRAIN;
+        io_uring_sqe_set_data(sqe, (void*)sync_tag);
+        io_uring_submit(&ring);
+        inflight ++;
+        reap(false);
+    }
+
+    void wait_all() {
+        while (inflight > 0)
+            reap(true);
+    }
+
+    //a write or a sync failed, what it held is not in the file
+    bool failed = false;
+
+private:
+    struct buffer {
+        char*    data = nullptr;
+        size_t   used = 0;
+        uint64_t offset = 0;
+        int      fd = -1;
+        bool     busy = false;  //handed to the kernel
+    };
+
+    static constexpr uintptr_t sync_tag = UINTPTR_MAX;
+
+    io_uring_sqe* get_sqe() {
+        io_uring_sqe* sqe;
+        while (!(sqe = io_uring_get_sqe(&ring))) {
+            io_uring_submit(&ring);
+            reap(true);
+        }
+        return sqe;
+    }
+
+    unsigned acquire() {
+        while (free_buffers.empty())
+            reap(true);
+        unsigned i = free_buffers.back();
+        free_buffers.pop_back();
+        buffers[i].used = 0;
+        return i;
+    }
+
+    void reap(bool wait) {
+        io_uring_cqe* cqe = nullptr;
+        int ret = wait ? io_uring_wait_cqe(&ring, &cqe) : io_uring_peek_cqe(&ring, &cqe);
+        while (ret == 0 && cqe) {
+            auto tag = (uintptr_t)io_uring_cqe_get_data(cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            if (inflight > 0) inflight --;
+            if (tag == sync_tag) {
+                if (res < 0) {
+                    elog ("data-plugin file producer : fdatasync failed. [errno=${errno}]", ("errno", -res));
+                    failed = true;
+                }
+            } else {
+                complete(tag, res);
+            }
+            ret = io_uring_peek_cqe(&ring, &cqe);
+        }
+        if (wait && ret < 0 && ret != -EAGAIN && ret != -EINTR) {
+            //nothing more can be learned of the ops in flight, they are taken as failed
+            elog ("data-plugin file producer : io_uring wait failed, ${n} ops in flight taken as failed. [errno=${errno}]",
+                  ("n", inflight)("errno", -ret));
+            for (unsigned i = 0; i < buffers.size(); i ++) {
+                if (!buffers[i].busy) continue;
+                buffers[i].busy = false;
+                buffers[i].used = 0;
+                free_buffers.push_back(i);
+            }
+            inflight = 0;
+            failed = true;
+        }
+    }
+
+    //a short write is finished with pwrite, it only happens on a full disk or a signal
+    void complete(unsigned i, int res) {
+        auto& b = buffers[i];
+        //a late completion of an op already taken as failed
+        if (!b.busy) return;
+        b.busy = false;
+        size_t done = res < 0 ? 0 : size_t(res);
+        if (res < 0 && res != -EINTR && res != -EAGAIN) {
+            elog ("data-plugin file producer : write failed. [errno=${errno}]", ("errno", -res));
+            failed = true;
+        } else {
+            while (done < b.used) {
+                auto n = ::pwrite(b.fd, b.data + done, b.used - done, b.offset + done);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    elog ("data-plugin file producer : write failed. [errno=${errno}]", ("errno", errno));
+                    failed = true;
+                    break;
+                }
+                done += n;
+            }
+        }
+        b.used = 0;
+        free_buffers.push_back(i);
+    }
+
+    io_uring ring;
+    bool ready = false;
+    bool registered = false;
+    size_t buffer_size = 0;
+    vector<buffer> buffers;
+    vector<unsigned> free_buffers;
+    unsigned current = 0;
+    uint32_t inflight = 0;
+};
+
+}}
+
+#endif
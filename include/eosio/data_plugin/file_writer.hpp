@@ -0,0 +1,200 @@
+#pragma once
+
+#include <time.h>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <fc/log/logger.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <eosio/data_plugin/file_output.hpp>
+#include <eosio/data_plugin/file_archive.hpp>
+#include <eosio/data_plugin/file_columnar.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+/**
+ * formats and writes file_records on its own thread.
+ * the caller only pushes a pointer into a lock free queue; json serialization,
+ * rotation and the write syscalls happen on the writer thread.
+ * with split_by_name every destination name gets its own file, buffer and rotation.
+ *
+ * a block mark goes through the queue behind the records before it, and is confirmed once
+ * the outputs holding those records have flushed them to the file (fsynced with the flush
+ * fsync policy). a row group still being built is not in the file yet, and a flush which
+ * fails leaves the mark unconfirmed until a later one succeeds.
+ */
+struct file_writer {
+    struct config : file_output_config {
+        uint32_t flush_interval_ms = 1000;
+        size_t queue_size = 65536;
+        bool split_by_name = false;
+    };
+
+    ~file_writer() {
+        stop();
+    }
+
+    //confirmed starts at the block marked before the writer, none of its records are before it
+    void start(const config& c, uint32_t confirmed_block = 0) {
+        conf = c;
+        confirmed_block_num = confirmed_block;
+        queue = std::make_unique<boost::lockfree::queue<file_record*> >(conf.queue_size);
+        done = false;
+        thread = std::thread([this](){ run(); });
+    }
+
+    void stop() {
+        if (!thread.joinable()) return;
+        done = true;
+        wakeup.notify_one();
+        thread.join();
+        for (auto& output : outputs) {
+            if (output.second->close())
+                output.second->flushed = output.second->written;
+        }
+        confirm();
+    }
+
+    void push(file_record* record) {
+        //block the caller while the writer is behind instead of growing without bound
+        while (!queue->bounded_push(record)) {
+            if (!full_warned.exchange(true))
+                wlog ("data-plugin file producer : queue is full, wait for the writer");
+            std::this_thread::yield();
+        }
+        if (idle.load(std::memory_order_acquire))
+            wakeup.notify_one();
+    }
+
+    //every record of the block and before it has been pushed
+    void mark(uint32_t block_num) {
+        push(new file_record{string(), string(), fc::variant(), block_num});
+    }
+
+    //the last marked block whose records are in the file
+    uint32_t confirmed() const {
+        return confirmed_block_num;
+    }
+
+private:
+    void run() {
+        auto next_flush = std::chrono::steady_clock::now() + std::chrono::milliseconds(conf.flush_interval_ms);
+        while (true) {
+            file_record* record = nullptr;
+            bool busy = false;
+            while (queue->pop(record)) {
+                busy = true;
+                if (record->mark) {
+                    add_mark(record->mark);
+                    delete record;
+                    continue;
+                }
+                file_output* output = nullptr;
+                try {
+                    output = &output_for(record->name);
+                    output->write(*record, time(NULL));
+                } catch (const fc::exception& ex) {
+                    elog ("data-plugin file producer : write ${name} failed : ${ex}", ("name", record->name)("ex", ex.to_string()));
+                } catch (const std::exception& ex) {
+                    elog ("data-plugin file producer : write ${name} failed : ${ex}", ("name", record->name)("ex", ex.what()));
+                }
+                //a failed record is counted too, it would hold the marks after it forever
+                if (output) output->written ++;
+                delete record;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_flush) {
+                flush();
+                next_flush = now + std::chrono::milliseconds(conf.flush_interval_ms);
+            }
+            if (busy) continue;
+            if (done) break;
+            std::unique_lock<std::mutex> lock(mtx);
+            idle.store(true, std::memory_order_release);
+            if (queue->empty() && !done)
+                wakeup.wait_until(lock, next_flush);
+            idle.store(false, std::memory_order_release);
+            full_warned = false;
+        }
+        flush();
+    }
+
+    file_output& output_for(const string& name) {
+        auto& output = outputs[conf.split_by_name ? name : string()];
+        if (!output) {
+            file_output_config c = conf;
+            if (conf.split_by_name)
+                c.path = conf.path.string() + "." + name;
+            const columnar_schema* schema = nullptr;
+            if (c.format == file_output_config::columnar && !(schema = find_columnar_schema(name))) {
+                //only the flat analytics structs have a column layout
+                wlog ("data-plugin file producer : no columnar schema for ${name}, write it as text", ("name", name));
+                c.format = file_output_config::text;
+            }
+            if (c.format == file_output_config::archive)
+                output = std::make_unique<archive_output>(c);
+            else if (c.format == file_output_config::columnar)
+                output = std::make_unique<columnar_output>(c, name, *schema);
+            else
+                output = std::make_unique<text_output>(c);
+        }
+        return *output;
+    }
+
+    void flush() {
+        for (auto& output : outputs) {
+            if (output.second->flush())
+                output.second->flushed = output.second->written - output.second->held();
+        }
+        confirm();
+    }
+
+    //the outputs with records not in the file yet, and how many they have to flush for the mark
+    void add_mark(uint32_t block_num) {
+        pending_mark m{block_num, {}};
+        for (auto& output : outputs)
+            if (output.second->written > output.second->flushed)
+                m.outputs.push_back({output.second.get(), output.second->written});
+        marks.push_back(std::move(m));
+        confirm();
+    }
+
+    void confirm() {
+        while (!marks.empty()) {
+            auto& m = marks.front();
+            for (auto& o : m.outputs)
+                if (o.first->flushed < o.second) return;
+            confirmed_block_num = m.block_num;
+            marks.pop_front();
+        }
+    }
+
+    struct pending_mark {
+        uint32_t block_num;
+        std::vector<std::pair<file_output*, uint64_t> > outputs;
+    };
+
+    config conf;
+    std::map<string, std::unique_ptr<file_output> > outputs;
+    std::unique_ptr<boost::lockfree::queue<file_record*> > queue;
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable wakeup;
+    std::atomic<bool> done{false};
+    std::atomic<bool> idle{false};
+    std::atomic<bool> full_warned{false};
+    std::deque<pending_mark> marks;
+    //written by the writer thread, read by the one checkpointing
+    std::atomic<uint32_t> confirmed_block_num{0};
+};
+
+}}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <queue>
+#include <vector>
+#include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
+#include <eosio/chain/trace.hpp>
+
+namespace eosio{ namespace data{
+
+using std::vector;
+
+/**
+ * the action traces of a transaction in breadth first order, top level actions first.
+ * every variant carries index_in_transaction and parent_global_sequence (-1 for top level),
+ * natives holds the action_trace of the same index so builders can read act.data directly.
+ */
+struct flat_trace {
+    vector<fc::variant> actions;
+    //empty when the variant does not have the shape of the native trace
+    vector<const chain::action_trace*> natives;
+
+    const chain::action_trace* native(size_t i) const {
+        return i < natives.size() ? natives[i] : nullptr;
+    }
+};
+
+//bumped by the data plugin for every chain event, flatten() caches within one event
+inline uint64_t& trace_event_seq() {
+    static thread_local uint64_t seq = 0;
+    return seq;
+}
+
+/**
+ * flatten the trace of an applied transaction once per event, whatever the number of
+ * structs built from it. outside of the data plugin callback nothing is cached.
+ */
+inline const flat_trace& flatten(const chain::transaction_trace_ptr& ttp, const fc::mutable_variant_object& obj) {
+    static thread_local flat_trace cache;
+    static thread_local uint64_t cached_seq = 0;
+    static thread_local const chain::transaction_trace* cached_ttp = nullptr;
+    auto seq = trace_event_seq();
+    if (seq != 0 && seq == cached_seq && cached_ttp == ttp.get())
+        return cache;
+    cached_seq = seq;
+    cached_ttp = ttp.get();
+    cache.actions.clear();
+    cache.natives.clear();
+
+    if (obj.find("action_traces") != obj.end()) {
+        std::queue<fc::variant> todo_action_traces;
+        for (auto trace : obj["action_traces"].get_array()) {
+            fc::mutable_variant_object traceobj(trace);
+            traceobj.set("index_in_transaction", static_cast<uint32_t>(cache.actions.size()));
+            traceobj.set("parent_global_sequence", -1);
+            cache.actions.push_back(traceobj);
+            if (!trace.get_object()["inline_traces"].get_array().empty())
+                todo_action_traces.push(trace);
+        }
+        while (!todo_action_traces.empty()) {
+            auto trace = todo_action_traces.front();
+            todo_action_traces.pop();
+            for (auto itrace : trace.get_object()["inline_traces"].get_array()) {
+                fc::mutable_variant_object traceobj(itrace);
+                traceobj.set("index_in_transaction", static_cast<uint32_t>(cache.actions.size()));
+                traceobj.set("parent_global_sequence", trace.get_object()["receipt"].get_object()["global_sequence"]);
+                cache.actions.push_back(traceobj);
+                if (!itrace.get_object()["inline_traces"].get_array().empty())
+                    todo_action_traces.push(itrace);
+            }
+        }
+    }
+
+    std::queue<const chain::action_trace*> todo;
+    for (auto& trace : ttp->action_traces) {
+        cache.natives.push_back(&trace);
+        todo.push(&trace);
+    }
+    while (!todo.empty()) {
+        auto trace = todo.front();
+        todo.pop();
+        for (auto& itrace : trace->inline_traces) {
+            cache.natives.push_back(&itrace);
+            todo.push(&itrace);
+        }
+    }
+    bool same = cache.natives.size() == cache.actions.size();
+    for (size_t i = 0; same && i < cache.natives.size(); i ++) {
+        auto& receipt = cache.actions[i].get_object()["receipt"].get_object();
+        same = receipt["global_sequence"].as_uint64() == cache.natives[i]->receipt.global_sequence;
+    }
+    if (!same)
+        cache.natives.clear();
+    return cache;
+}
+
+}}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <unordered_set>
+#include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/exception/exception.hpp>
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/trace.hpp>
+
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+using std::vector;
+
+struct abstract_type;
+
+/**
+ * holds what the reversible chain events produce until the fork they belong to is settled.
+ *
+ *   all                 : no buffer, every event is produced as it comes (speculative and
+ *                         re-applied transactions included)
+ *   irreversible-only   : records are produced once their block is irreversible
+ *   reversible+retract  : records are produced once their block is accepted, the records of
+ *                         a block which gets forked out are produced again as retractions
+ *
+ * transaction records wait for the accepted block including them, keyed by trx id so a
+ * transaction applied again (speculatively, then in the block) keeps its last records only.
+ * accepted transactions do not know their block yet and wait for any block including them.
+ * transactions no accepted block includes are dropped once their height is irreversible.
+ */
+struct fork_buffer {
+    enum fork_mode {
+        all,
+        irreversible_only,
+        reversible_retract
+    };
+
+    static fork_mode parse_mode(const string& m) {
+        if (m == "all")                return all;
+        if (m == "irreversible-only")  return irreversible_only;
+        if (m == "reversible+retract") return reversible_retract;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown fork mode ${m}, expect all/irreversible-only/reversible+retract", ("m", m));
+    }
+
+    struct record {
+        abstract_type* type;
+        string name;
+        string key;
+        fc::variant value;
+    };
+    typedef vector<record> records;
+
+    explicit fork_buffer(fork_mode m = all) : mode(m) {}
+
+    //the records of an applied or accepted transaction, block_num is the block it was applied in
+    void add_transaction(uint32_t block_num, const chain::transaction_id_type& id, records&& rs, bool implicit = false) {
+        auto& trx = pending[block_num][id];
+        trx.rs = std::move(rs);
+        trx.implicit = trx.implicit || implicit;
+    }
+
+    //the records of a transaction not in a block yet, head_num is the head block when it came
+    void add_unplaced(uint32_t head_num, const chain::transaction_id_type& id, records&& rs) {
+        auto& trx = unplaced[id];
+        trx.first = head_num;
+        trx.second = std::move(rs);
+    }
+
+    //what to produce now for an accepted block and the records built from it
+    records accept_block(const chain::block_state_ptr& bsp, records&& block_records) {
+        records now;
+        //a block at this height or above was accepted before : it is forked out with its successors
+        auto forked = blocks.lower_bound(bsp->block_num);
+        for (auto it = forked; it != blocks.end(); ++ it)
+            retract(it->first, it->second, now);
+        blocks.erase(forked, blocks.end());
+
+        auto& entry = blocks[bsp->block_num];
+        entry.id = bsp->id;
+        entry.rs = std::move(block_records);
+        std::unordered_set<string> included;
+        for (auto& receipt : bsp->block->transactions) {
+            auto id = receipt.trx.contains<chain::transaction_id_type>()
+                ? receipt.trx.get<chain::transaction_id_type>()
+                : receipt.trx.get<chain::packed_transaction>().id();
+            included.insert(string(id));
+            auto trx = unplaced.find(id);
+            if (trx == unplaced.end()) continue;
+            for (auto& r : trx->second.second)
+                entry.rs.push_back(std::move(r));
+            unplaced.erase(trx);
+        }
+        auto trxs = pending.find(bsp->block_num);
+        if (trxs != pending.end()) {
+            for (auto& trx : trxs->second) {
+                if (!trx.second.implicit && !included.count(string(trx.first))) continue;
+                for (auto& r : trx.second.rs)
+                    entry.rs.push_back(std::move(r));
+            }
+        }
+        pending.erase(pending.begin(), pending.upper_bound(bsp->block_num));
+
+        if (mode == reversible_retract) {
+            for (auto& r : entry.rs)
+                entry.emitted.push_back({r.type, r.name, r.key, fc::variant()});
+            now.insert(now.end(), std::make_move_iterator(entry.rs.begin()), std::make_move_iterator(entry.rs.end()));
+            entry.rs.clear();
+        }
+        return now;
+    }
+
+    //what to produce now that a block is irreversible
+    records irreversible_block(const chain::block_state_ptr& bsp) {
+        records now;
+        auto it = blocks.find(bsp->block_num);
+        if (it != blocks.end() && it->second.id != bsp->id) {
+            //accepted last on a fork which lost
+            retract(it->first, it->second, now);
+            it->second.rs.clear();
+        }
+        if (it != blocks.end() && it->second.id == bsp->id && mode == irreversible_only)
+            now = std::move(it->second.rs);
+        blocks.erase(blocks.begin(), blocks.upper_bound(bsp->block_num));
+        pending.erase(pending.begin(), pending.upper_bound(bsp->block_num));
+        for (auto trx = unplaced.begin(); trx != unplaced.end(); ) {
+            if (trx->second.first <= bsp->block_num) trx = unplaced.erase(trx);
+            else ++ trx;
+        }
+        return now;
+    }
+
+    size_t buffered_blocks() const {
+        return blocks.size();
+    }
+
+    fork_mode mode;
+
+private:
+    struct pending_trx {
+        records rs;
+        bool implicit = false;
+    };
+
+    struct block_entry {
+        chain::block_id_type id;
+        //waiting for irreversibility
+        records rs;
+        //already produced, only type, name and key are kept
+        records emitted;
+    };
+
+    void retract(uint32_t block_num, const block_entry& entry, records& now) {
+        for (auto& r : entry.emitted) {
+            now.push_back({r.type, r.name + ".retract", r.key,
+                           fc::mutable_variant_object("retract", true)("block_num", block_num)("block_id", entry.id)});
+        }
+    }
+
+    map<uint32_t, map<chain::transaction_id_type, pending_trx> > pending;
+    map<uint32_t, block_entry> blocks;
+    map<chain::transaction_id_type, std::pair<uint32_t, records> > unplaced;
+};
+
+}}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fc/variant.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+using std::vector;
+
+/**
+ * nanosecond latencies in power of two buckets, bucket i holds [2^i, 2^(i+1))
+ */
+struct latency_histogram {
+    void add(uint64_t ns) {
+        buckets[ns ? 63 - __builtin_clzll(ns) : 0] ++;
+        count ++;
+        sum += ns;
+    }
+
+    void merge(const latency_histogram& other) {
+        for (size_t i = 0; i < buckets.size(); i ++)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        sum += other.sum;
+    }
+
+    //the upper bound of the bucket holding the quantile
+    uint64_t quantile(double q) const {
+        if (!count) return 0;
+        uint64_t rank = uint64_t(q * count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i ++) {
+            seen += buckets[i];
+            if (seen > rank) return uint64_t(2) << i;
+        }
+        return uint64_t(-1);
+    }
+
+    std::array<uint64_t, 64> buckets = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+};
+
+/**
+ * what the dispatch loop of the data plugin costs, per struct and per producer.
+ *
+ * every thread counts into its own shard, locked only by its owner and by the report, so
+ * the counting threads never wait on each other. one event in sample is timed and its
+ * records measured as json; counts are exact, times and bytes come from the samples.
+ */
+struct dispatch_metrics {
+    struct type_counters {
+        uint64_t events = 0;
+        uint64_t records = 0;
+        uint64_t sampled_records = 0;
+        uint64_t sampled_bytes = 0;
+        latency_histogram build;
+    };
+
+    struct producer_counters {
+        uint64_t records = 0;
+        latency_histogram produce;
+    };
+
+    struct counters {
+        uint64_t events = 0;
+        map<string, latency_histogram> to_variant;
+        map<string, type_counters> types;
+        map<string, producer_counters> producers;
+    };
+
+    struct shard : counters {
+        std::mutex mtx;
+    };
+
+    //true for the events to time, counted per thread
+    bool sample_event() {
+        static thread_local uint64_t seq = 0;
+        return enabled && sample && ++seq % sample == 0;
+    }
+
+    shard& local() {
+        static thread_local shard* mine = nullptr;
+        if (!mine) {
+            std::lock_guard<std::mutex> lock(mtx);
+            shards.emplace_back(new shard());
+            mine = shards.back().get();
+        }
+        return *mine;
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //the counters of every thread added up, since the last report if reset
+    counters collect(bool reset) {
+        counters total;
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> shard_lock(s->mtx);
+            total.events += s->events;
+            for (auto& kv : s->to_variant)
+                total.to_variant[kv.first].merge(kv.second);
+            for (auto& kv : s->types) {
+                auto& t = total.types[kv.first];
+                t.events += kv.second.events;
+                t.records += kv.second.records;
+                t.sampled_records += kv.second.sampled_records;
+                t.sampled_bytes += kv.second.sampled_bytes;
+                t.build.merge(kv.second.build);
+            }
+            for (auto& kv : s->producers) {
+                auto& p = total.producers[kv.first];
+                p.records += kv.second.records;
+                p.produce.merge(kv.second.produce);
+            }
+            if (reset) {
+                s->events = 0;
+                s->to_variant.clear();
+                s->types.clear();
+                s->producers.clear();
+            }
+        }
+        return total;
+    }
+
+    //one line per struct and per producer, queue_depths by producer name
+    void report(double seconds, const map<string, uint64_t>& queue_depths) {
+        auto total = collect(true);
+        if (!total.events) return;
+        for (auto& kv : total.to_variant)
+            ilog ("data-plugin metrics ${event} to_variant_with_abi : p50=${p50}us p99=${p99}us over ${n} sampled",
+                  ("event", kv.first)("p50", kv.second.quantile(0.5) / 1000)("p99", kv.second.quantile(0.99) / 1000)("n", kv.second.count));
+        for (auto& kv : total.types) {
+            auto& t = kv.second;
+            ilog ("data-plugin metrics struct ${t} : ${records} records/s, ${bytes} bytes/s, build p50=${p50}us p99=${p99}us",
+                  ("t", kv.first)("records", uint64_t(t.records / seconds))
+                  ("bytes", t.sampled_records ? uint64_t(double(t.sampled_bytes) / t.sampled_records * t.records / seconds) : 0)
+                  ("p50", t.build.quantile(0.5) / 1000)("p99", t.build.quantile(0.99) / 1000));
+        }
+        for (auto& kv : total.producers) {
+            auto depth = queue_depths.find(kv.first);
+            ilog ("data-plugin metrics producer ${p} : ${records} records/s, produce p50=${p50}us p99=${p99}us, queue depth ${depth}",
+                  ("p", kv.first)("records", uint64_t(kv.second.records / seconds))
+                  ("p50", kv.second.produce.quantile(0.5) / 1000)("p99", kv.second.produce.quantile(0.99) / 1000)
+                  ("depth", depth == queue_depths.end() ? 0 : depth->second));
+        }
+    }
+
+    bool enabled = false;
+    uint32_t sample = 16;
+
+private:
+    std::mutex mtx;
+    vector<std::unique_ptr<shard> > shards;
+};
+
+inline dispatch_metrics& metrics() {
+    static dispatch_metrics m;
+    return m;
+}
+
+}}
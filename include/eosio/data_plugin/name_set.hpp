@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace eosio{ namespace data{
+
+/**
+ * insertion ordered set of tuples of N name values, open addressing with linear probing.
+ * meant to be reused per thread : clear() keeps the memory.
+ */
+template <size_t N>
+struct name_tuple_set {
+    typedef std::array<uint64_t, N> tuple;
+
+    //return false if the tuple was already there
+    bool insert(const tuple& t) {
+        if ((items.size() + 1) * 2 > slots.size())
+            grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(t) & mask; ; i = (i + 1) & mask) {
+            auto slot = slots[i];
+            if (slot == 0) {
+                items.push_back(t);
+                slots[i] = uint32_t(items.size());
+                return true;
+            }
+            if (items[slot - 1] == t)
+                return false;
+        }
+    }
+
+    void clear() {
+        if (items.empty()) return;
+        items.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    //in the order of insertion
+    std::vector<tuple> items;
+
+private:
+    static size_t hash(const tuple& t) {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for (auto v : t) {
+            h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            h *= 0xff51afd7ed558ccdull;
+        }
+        return size_t(h ^ (h >> 32));
+    }
+
+    void grow() {
+        slots.assign(std::max<size_t>(16, slots.size() * 2), 0);
+        size_t mask = slots.size() - 1;
+        for (uint32_t n = 0; n < items.size(); n ++) {
+            size_t i = hash(items[n]) & mask;
+            while (slots[i]) i = (i + 1) & mask;
+            slots[i] = n + 1;
+        }
+    }
+
+    //index + 1 into items, 0 is empty
+    std::vector<uint32_t> slots;
+};
+
+}}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <fc/variant.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/algorithm/string.hpp>
+#include <eosio/data_plugin/producers.hpp>
+
+namespace eosio{ namespace data{
+
+/**
+ * a producer behind its own bounded queue and consumer thread, so a slow sink only holds
+ * up itself. the dispatcher hands records and block marks over in order, the consumer
+ * calls the producer with them in the same order.
+ *
+ * the queue counts the records waiting here plus those the producer still holds in memory
+ * (memory_depth), a producer which hands records over to its own thread like http is
+ * bounded as well. when full, block waits for room (no loss, the dispatcher and so every
+ * other producer waits too), drop-newest drops the record handed over and drop-oldest the
+ * oldest record waiting here, or the newest if the producer holds them all. marks are never
+ * dropped : a lossy producer confirms its blocks anyway.
+ *
+ * health is healthy, degraded (queue past half full or records dropped since the last
+ * check) or stalled (records queued and none produced nor drained by the producer for stall
+ * seconds). changes are logged.
+ *
+ * configured as capacity=100000;policy=block|drop-newest|drop-oldest;stall=30.
+ */
+struct producer_queue : abstract_producer {
+    enum drop_policy {
+        block,
+        drop_newest,
+        drop_oldest
+    };
+
+    enum health_state {
+        healthy,
+        degraded,
+        stalled
+    };
+
+    struct options {
+        explicit options(const string& spec = string()) {
+            std::vector<string> items;
+            boost::split(items, spec, boost::is_any_of(";"));
+            for (auto& item : items) {
+                if (item.empty()) continue;
+                auto pos = item.find('=');
+                FC_ASSERT(pos != string::npos, "producer queue option should be name=value : ${i}", ("i", item));
+                auto name = item.substr(0, pos);
+                auto value = item.substr(pos + 1);
+                if (name == "capacity")    capacity = std::stoul(value);
+                else if (name == "policy") policy = parse_policy(value);
+                else if (name == "stall")  stall_sec = std::stoul(value);
+                else FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown producer queue option ${i}", ("i", item));
+            }
+        }
+
+        //0 to call the producer directly
+        size_t capacity = 100000;
+        drop_policy policy = block;
+        uint32_t stall_sec = 30;
+    };
+
+    static drop_policy parse_policy(const string& p) {
+        if (p == "block")       return block;
+        if (p == "drop-newest") return drop_newest;
+        if (p == "drop-oldest") return drop_oldest;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown producer queue policy ${p}, expect block/drop-newest/drop-oldest", ("p", p));
+    }
+
+    static const char* health_name(health_state h) {
+        switch (h) {
+            case healthy:  return "healthy";
+            case degraded: return "degraded";
+            default:       return "stalled";
+        }
+    }
+
+    producer_queue(const shared_ptr<abstract_producer>& target, const string& name, const options& opts)
+        : target(target), name(name), opts(opts) {}
+
+    ~producer_queue() {
+        close();
+    }
+
+    void produce(const string& record_name, const string& key, fc::variant& value) override {
+        //events replayed before startup go straight to the producer, as before
+        if (!consumer.joinable()) {
+            target->produce(record_name, key, value);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        if (closed) return;
+        if (depth() >= opts.capacity) {
+            if (opts.policy == drop_oldest && records) {
+                for (auto it = items.begin(); it != items.end(); ++ it) {
+                    if (it->is_mark) continue;
+                    items.erase(it);
+                    records --;
+                    dropped ++;
+                    break;
+                }
+            } else if (opts.policy != block) {
+                dropped ++;
+                check_health(lock);
+                return;
+            } else {
+                //the producer drains its own part without a word, look again now and then
+                while (!closed && depth() >= opts.capacity) {
+                    room.wait_for(lock, std::chrono::milliseconds(10));
+                    check_health(lock);
+                }
+                if (closed) return;
+            }
+        }
+        //the variant is shared with the other producers, a copy only takes a reference
+        items.push_back({false, 0, record_name, key, value});
+        records ++;
+        check_health(lock);
+        ready.notify_one();
+    }
+
+    void mark(uint32_t block_num) override {
+        if (!consumer.joinable()) {
+            target->mark(block_num);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (closed) return;
+        items.push_back({true, block_num, string(), string(), fc::variant()});
+        ready.notify_one();
+    }
+
+    uint32_t confirmed() override {
+        return target->confirmed();
+    }
+
+    uint64_t queue_depth() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return records + target->queue_depth();
+    }
+
+    uint64_t memory_depth() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return depth();
+    }
+
+    void set_program_options(options_description& cli, options_description& cfg) override {
+        target->set_program_options(cli, cfg);
+    }
+
+    void initialize(const variables_map& options) override {
+        target->initialize(options);
+    }
+
+    void startup() override {
+        target->startup();
+        last_progress = std::chrono::steady_clock::now();
+        consumer = std::thread([this]() { consume(); });
+    }
+
+    //what is queued is produced before the producer stops
+    void stop() override {
+        close();
+        target->stop();
+        if (dropped)
+            wlog ("data-plugin producer ${p} dropped ${n} records, queue full", ("p", name)("n", uint64_t(dropped)));
+    }
+
+    health_state health() {
+        std::unique_lock<std::mutex> lock(mtx);
+        return check_health(lock);
+    }
+
+private:
+    struct item {
+        bool is_mark;
+        uint32_t block_num;
+        string name;
+        string key;
+        fc::variant value;
+    };
+
+    void consume() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            ready.wait(lock, [this]() { return !items.empty() || closed; });
+            if (items.empty()) return;
+            auto next = std::move(items.front());
+            items.pop_front();
+            if (!next.is_mark) {
+                records --;
+                room.notify_one();
+            }
+            lock.unlock();
+            try {
+                if (next.is_mark)
+                    target->mark(next.block_num);
+                else
+                    target->produce(next.name, next.key, next.value);
+            } catch (const fc::exception& ex) {
+                elog ("data-plugin producer ${p} failed : ${ex}", ("p", name)("ex", ex.to_detail_string()));
+            } catch (const std::exception& ex) {
+                elog ("data-plugin producer ${p} failed : ${ex}", ("p", name)("ex", ex.what()));
+            }
+            lock.lock();
+            last_progress = std::chrono::steady_clock::now();
+            if (state != healthy)
+                check_health(lock);
+        }
+    }
+
+    //called with the lock held
+    size_t depth() {
+        return records + target->memory_depth();
+    }
+
+    //called with the lock held
+    health_state check_health(std::unique_lock<std::mutex>&) {
+        auto time = std::chrono::steady_clock::now();
+        auto target_depth = target->memory_depth();
+        if (target_depth < last_target_depth)
+            last_progress = time;
+        last_target_depth = target_depth;
+        auto queued = records + target_depth;
+        health_state now = healthy;
+        if (queued && time - last_progress > std::chrono::seconds(opts.stall_sec))
+            now = stalled;
+        else if (queued > opts.capacity / 2 || dropped > dropped_checked)
+            now = degraded;
+        dropped_checked = dropped;
+        if (now != state) {
+            if (now == healthy)
+                ilog ("data-plugin producer ${p} is healthy again, ${n} records queued", ("p", name)("n", queued));
+            else
+                wlog ("data-plugin producer ${p} is ${h}, ${n} records queued, ${d} dropped",
+                      ("p", name)("h", health_name(now))("n", queued)("d", uint64_t(dropped)));
+            state = now;
+        }
+        return state;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closed) return;
+            closed = true;
+        }
+        ready.notify_all();
+        room.notify_all();
+        if (consumer.joinable())
+            consumer.join();
+    }
+
+    shared_ptr<abstract_producer> target;
+    string name;
+    options opts;
+    std::mutex mtx;
+    std::condition_variable ready;
+    std::condition_variable room;
+    std::deque<item> items;
+    size_t records = 0;
+    uint64_t last_target_depth = 0;
+    std::atomic<uint64_t> dropped{0};
+    uint64_t dropped_checked = 0;
+    health_state state = healthy;
+    std::chrono::steady_clock::time_point last_progress;
+    std::thread consumer;
+    bool closed = false;
+};
+
+}}
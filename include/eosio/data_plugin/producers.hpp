@@ -1,6 +1,10 @@
 #pragma once
 
 #include <map>
+#include <set>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <fc/variant.hpp>
@@ -18,12 +22,73 @@ using boost::program_options::variables_map;
 using boost::program_options::options_description;
 namespace bpo = boost::program_options;
 
+/**
+ * which blocks an asynchronous producer has delivered. every record gets a sequence number
+ * when handed over; a marked block is delivered once no record handed over before the
+ * mark is outstanding. a record which fails for good stays outstanding, so the delivered
+ * block stops there. thread safe, deliveries usually come from an io thread.
+ */
+struct delivery_tracker {
+    uint64_t sent() {
+        std::lock_guard<std::mutex> lock(mtx);
+        outstanding.insert(next_seq);
+        return next_seq ++;
+    }
+
+    void delivered(uint64_t seq) {
+        std::lock_guard<std::mutex> lock(mtx);
+        outstanding.erase(seq);
+    }
+
+    void mark(uint32_t block_num) {
+        std::lock_guard<std::mutex> lock(mtx);
+        marks.push_back({next_seq, block_num});
+    }
+
+    //the last marked block with every record before it delivered, 0 if none
+    uint32_t confirmed() {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t lowest = outstanding.empty() ? next_seq : *outstanding.begin();
+        while (!marks.empty() && marks.front().first <= lowest) {
+            last_confirmed = marks.front().second;
+            marks.pop_front();
+        }
+        return last_confirmed;
+    }
+
+private:
+    std::mutex mtx;
+    uint64_t next_seq = 0;
+    std::set<uint64_t> outstanding;
+    std::deque<std::pair<uint64_t, uint32_t> > marks;
+    uint32_t last_confirmed = 0;
+};
+
 struct abstract_producer {
     virtual void produce (const string& name, const string& key, fc::variant& value) = 0;
     virtual void set_program_options(options_description& cli, options_description& cfg) = 0;
     virtual void initialize(const variables_map& options) = 0;
     virtual void startup() = 0;
     virtual void stop() = 0;
+    //the records handed over and not delivered yet, as far as the producer knows
+    virtual uint64_t queue_depth() {
+        return 0;
+    }
+    //the part of queue_depth held in memory, what a queue in front of the producer has to bound
+    virtual uint64_t memory_depth() {
+        return queue_depth();
+    }
+    //every record of the block and before it has been handed over
+    virtual void mark(uint32_t block_num) {
+        marked = block_num;
+    }
+    //the last marked block whose records are delivered, producers writing synchronously deliver on produce
+    virtual uint32_t confirmed() {
+        return marked;
+    }
+protected:
+    //marked from the thread producing, read from the one checkpointing
+    std::atomic<uint32_t> marked{0};
 };
 
 template <typename successor>
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/exception/exception.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace eosio{ namespace data{
+
+using std::map;
+using std::string;
+using std::vector;
+
+/**
+ * the fields a struct keeps in its records, configured as include:a,b.c or exclude:a,b.
+ *
+ * paths go through objects by field name and through arrays element by element, a path
+ * keeps or drops the whole value at its end. builders ask wants() before computing a top
+ * level field so an excluded one is never built. every sample-th record is built whole
+ * and measured to report the bytes the projection saves.
+ */
+struct field_projection {
+    explicit field_projection(const string& spec) {
+        auto pos = spec.find(':');
+        FC_ASSERT(pos != string::npos, "fields should be include:paths or exclude:paths : ${s}", ("s", spec));
+        auto mode = spec.substr(0, pos);
+        if (mode == "include")      include = true;
+        else if (mode == "exclude") include = false;
+        else FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown fields mode ${m}, expect include/exclude", ("m", mode));
+        vector<string> paths;
+        boost::split(paths, spec.substr(pos + 1), boost::is_any_of(","));
+        for (auto& path : paths) {
+            if (path.empty()) continue;
+            vector<string> segments;
+            boost::split(segments, path, boost::is_any_of("."));
+            node* n = &root;
+            for (auto& segment : segments)
+                n = &n->children[segment];
+            n->leaf = true;
+        }
+        FC_ASSERT(!root.children.empty(), "fields without any path : ${s}", ("s", spec));
+    }
+
+    //if a top level field has to be built, always true for a measured record
+    bool wants(const string& field) const {
+        if (sampling()) return true;
+        auto it = root.children.find(field);
+        if (it == root.children.end()) return !include;
+        return include || !it->second.leaf;
+    }
+
+    fc::variant apply(const fc::variant& v) const {
+        return apply(root, v);
+    }
+
+    //bytes of a measured record before and after the projection
+    void measure(size_t before, size_t after, const string& type_name) {
+        sampled ++;
+        bytes_before += before;
+        bytes_after += after;
+        if (sampled % report_every == 0)
+            report(type_name);
+    }
+
+    void report(const string& type_name) const {
+        if (!sampled) return;
+        ilog ("data-plugin fields of ${t} : ${saved} bytes saved per record, ${before} -> ${after} bytes over ${n} sampled records",
+              ("t", type_name)("saved", (bytes_before - bytes_after) / sampled)
+              ("before", bytes_before)("after", bytes_after)("n", sampled));
+    }
+
+    //the record being built is measured, set by the data plugin
+    static bool& sampling() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    static size_t json_size(const fc::variant& v) {
+        return fc::json::to_string(v, fc::json::legacy_generator).size();
+    }
+
+    //one record in sample is measured, 0 for none
+    uint32_t sample = 1000;
+    uint64_t records = 0;
+    uint64_t report_every = 1000;
+
+private:
+    struct node {
+        map<string, node> children;
+        bool leaf = false;
+    };
+
+    fc::variant apply(const node& n, const fc::variant& v) const {
+        if (v.is_array()) {
+            fc::variants res;
+            res.reserve(v.get_array().size());
+            for (auto& item : v.get_array())
+                res.push_back(apply(n, item));
+            return res;
+        }
+        if (!v.is_object()) return v;
+        fc::mutable_variant_object res;
+        for (auto& kv : v.get_object()) {
+            auto it = n.children.find(kv.key());
+            if (it == n.children.end()) {
+                if (!include) res(kv.key(), kv.value());
+            } else if (it->second.leaf) {
+                if (include) res(kv.key(), kv.value());
+            } else {
+                res(kv.key(), apply(it->second, kv.value()));
+            }
+        }
+        return res;
+    }
+
+    bool include = true;
+    node root;
+    uint64_t sampled = 0;
+    uint64_t bytes_before = 0;
+    uint64_t bytes_after = 0;
+};
+
+}}
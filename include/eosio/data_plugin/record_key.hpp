@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fc/exception/exception.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+/**
+ * the keys of action and transaction records.
+ *
+ *   legacy : what the structs always produced, trx id hex followed by the bytes of
+ *            index_in_transaction as sign extended "%02x", kept bit for bit
+ *   binary : [salt][block_num big endian][first 8 bytes of trx id][index big endian],
+ *            16 bytes ordered by block then transaction then action
+ *   text   : the binary key in hex, for sinks which need printable keys
+ *
+ * a key led by block_num sends all writes of a moment to one region of an ordered store;
+ * with salt_buckets the keys start with a byte derived from the trx id which spreads them
+ * over that many ranges, a range scan then runs once per bucket.
+ */
+struct key_encoding {
+    enum key_format {
+        legacy,
+        text,
+        binary
+    };
+
+    static key_format parse_format(const string& f) {
+        if (f == "legacy") return legacy;
+        if (f == "text")   return text;
+        if (f == "binary") return binary;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown key format ${f}, expect legacy/text/binary", ("f", f));
+    }
+
+    string action(uint32_t block_num, const chain::transaction_id_type& trx_id, uint32_t index) const {
+        string key;
+        if (format == legacy) {
+            key.reserve(64 + 4 * 8);
+            append_hex(key, trx_id.data(), trx_id.data_size());
+            //the bytes of the index in memory order, signed chars as printf("%02x") prints them
+            const char* index_ptr = (const char*)&index;
+            for (size_t i = 0; i < sizeof(index); i ++) {
+                if (index_ptr[i] < 0) key.append("ffffff");
+                append_hex(key, index_ptr + i, 1);
+            }
+            return key;
+        }
+        char raw[17];
+        size_t len = compact_prefix(raw, block_num, trx_id);
+        put_be(raw + len, index);
+        return encode(raw, len + 4);
+    }
+
+    //the row key of a transaction, legacy is "%08x <trx id>"
+    string transaction(uint32_t block_num, const chain::transaction_id_type& trx_id) const {
+        string key;
+        if (format == legacy) {
+            char raw[4];
+            put_be(raw, block_num);
+            key.reserve(8 + 1 + 64);
+            append_hex(key, raw, sizeof(raw));
+            key += ' ';
+            append_hex(key, trx_id.data(), trx_id.data_size());
+            return key;
+        }
+        char raw[13];
+        return encode(raw, compact_prefix(raw, block_num, trx_id));
+    }
+
+    //the key as it can be written into a json body
+    string printable(const string& key) const {
+        if (format != binary) return key;
+        string res;
+        append_hex(res, key.data(), key.size());
+        return res;
+    }
+
+    key_format format = legacy;
+    uint32_t salt_buckets = 0;
+
+private:
+    static void put_be(char* p, uint32_t v) {
+        p[0] = char(v >> 24);
+        p[1] = char(v >> 16);
+        p[2] = char(v >> 8);
+        p[3] = char(v);
+    }
+
+    static void append_hex(string& out, const char* data, size_t len) {
+        static const char digits[] = "0123456789abcdef";
+        size_t pos = out.size();
+        out.resize(pos + len * 2);
+        for (size_t i = 0; i < len; i ++) {
+            uint8_t c = uint8_t(data[i]);
+            out[pos + i * 2]     = digits[c >> 4];
+            out[pos + i * 2 + 1] = digits[c & 0x0f];
+        }
+    }
+
+    //[salt][block_num][8 bytes of the trx id], return its length
+    size_t compact_prefix(char* p, uint32_t block_num, const chain::transaction_id_type& trx_id) const {
+        size_t len = 0;
+        if (salt_buckets)
+            p[len ++] = char(uint8_t(trx_id.data()[0]) % salt_buckets);
+        put_be(p + len, block_num);
+        len += 4;
+        memcpy(p + len, trx_id.data(), 8);
+        return len + 8;
+    }
+
+    string encode(const char* raw, size_t len) const {
+        if (format == binary) return string(raw, len);
+        string key;
+        append_hex(key, raw, len);
+        return key;
+    }
+};
+
+}}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <fc/time.hpp>
+#include <fc/exception/exception.hpp>
+#include <eosio/chain/block_timestamp.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+/**
+ * the table_suffix of a block time : "YYYYMM", "YYYYMMDD" or "YYYYMMDDHH" in UTC.
+ * computed from the timestamp with integer arithmetic, every thread keeps the last bucket
+ * of each granularity so a run of blocks in the same bucket costs a compare.
+ */
+struct time_bucket {
+    enum granularity {
+        month,
+        day,
+        hour
+    };
+
+    static granularity parse_granularity(const string& g) {
+        if (g == "month") return month;
+        if (g == "day")   return day;
+        if (g == "hour")  return hour;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown table suffix granularity ${g}, expect month/day/hour", ("g", g));
+    }
+
+    static const string& suffix(const chain::block_timestamp_type& t, granularity g) {
+        return suffix(fc::time_point(t).sec_since_epoch(), g);
+    }
+
+    static const string& suffix(int64_t sec, granularity g) {
+        struct cached {
+            int64_t begin = 1;
+            int64_t end = 0;
+            string  suffix;
+        };
+        static thread_local cached cache[3];
+        auto& c = cache[g];
+        if (sec < c.begin || sec >= c.end)
+            fill(sec, g, c.begin, c.end, c.suffix);
+        return c.suffix;
+    }
+
+private:
+    //days since 1970-01-01 to the civil date, see http://howardhinnant.github.io/date_algorithms.html
+    static void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+        z += 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        unsigned doe = unsigned(z - era * 146097);
+        unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        y = int64_t(yoe) + era * 400;
+        unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y += m <= 2;
+    }
+
+    static int64_t days_in_month(int64_t y, unsigned m) {
+        static const int64_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        return m == 2 && leap ? 29 : days[m - 1];
+    }
+
+    static void put(char* p, int64_t v, int width) {
+        for (int i = width - 1; i >= 0; i --, v /= 10)
+            p[i] = char('0' + v % 10);
+    }
+
+    static void fill(int64_t sec, granularity g, int64_t& begin, int64_t& end, string& suffix) {
+        int64_t days = (sec >= 0 ? sec : sec - 86399) / 86400;
+        int64_t sec_of_day = sec - days * 86400;
+        int64_t y;
+        unsigned m, d;
+        civil_from_days(days, y, m, d);
+        char buf[10];
+        put(buf, y, 4);
+        put(buf + 4, m, 2);
+        put(buf + 6, d, 2);
+        put(buf + 8, sec_of_day / 3600, 2);
+        switch (g) {
+            case month:
+                begin = (days - (d - 1)) * 86400;
+                end = begin + days_in_month(y, m) * 86400;
+                suffix.assign(buf, 6);
+                break;
+            case day:
+                begin = days * 86400;
+                end = begin + 86400;
+                suffix.assign(buf, 8);
+                break;
+            case hour:
+                begin = days * 86400 + sec_of_day / 3600 * 3600;
+                end = begin + 3600;
+                suffix.assign(buf, 10);
+                break;
+        }
+    }
+};
+
+}}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <fc/io/raw.hpp>
+#include <fc/variant.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/action.hpp>
+
+namespace eosio{ namespace data{
+
+using std::string;
+
+//the payload of the standard token transfer action
+struct token_transfer {
+    chain::account_name from;
+    chain::account_name to;
+    chain::asset        quantity;
+    string              memo;
+};
+
+}}
+
+FC_REFLECT(eosio::data::token_transfer, (from)(to)(quantity)(memo))
+
+namespace eosio{ namespace data{
+
+struct token_decoder_config {
+    //read transfer payloads from act.data instead of the abi decoded variant
+    bool fast_path = true;
+    //decode both ways and log where they differ
+    bool verify = false;
+};
+
+inline token_decoder_config& token_decoder() {
+    static token_decoder_config config;
+    return config;
+}
+
+/**
+ * unpack a transfer payload from the raw action data. the payload has to be consumed
+ * exactly and the asset has to be valid, anything else is left to the abi path.
+ */
+inline bool unpack_token_transfer(const chain::action& act, token_transfer& transfer) {
+    if (act.name != N(transfer)) return false;
+    try {
+        fc::datastream<const char*> ds(act.data.data(), act.data.size());
+        fc::raw::unpack(ds, transfer);
+        return ds.remaining() == 0 && transfer.quantity.is_valid();
+    } catch (const fc::exception& ex) {
+        return false;
+    }
+}
+
+//if the abi decoded data holds the same transfer
+inline bool same_token_transfer(const fc::variant& data, const token_transfer& transfer) {
+    try {
+        return data.is_object()
+            && data["from"].as<chain::account_name>() == transfer.from
+            && data["to"].as<chain::account_name>() == transfer.to
+            && data["quantity"].as<chain::asset>() == transfer.quantity
+            && data["memo"].as_string() == transfer.memo;
+    } catch (const fc::exception& ex) {
+        return false;
+    }
+}
+
+/**
+ * the transfer of an action trace read from act.data, false when the fast path is off or
+ * does not apply and the caller has to read the abi decoded data. deposit, withdraw and
+ * charge have no standard layout across contracts and always go through the abi.
+ * with verify on, the result is compared with the abi decoded data, which is only read then.
+ */
+inline bool decode_token_transfer(const chain::action_trace* native, const fc::variant& data, token_transfer& transfer) {
+    auto& config = token_decoder();
+    if (!config.fast_path || !native || !unpack_token_transfer(native->act, transfer))
+        return false;
+    if (config.verify && !same_token_transfer(data, transfer))
+        wlog ("data-plugin token fast path differs from abi : ${raw} != ${abi}", ("raw", transfer)("abi", data));
+    return true;
+}
+
+}}
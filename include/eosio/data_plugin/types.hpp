@@ -2,7 +2,18 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <fc/io/raw.hpp>
+#include <fc/io/json.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/crypto/base64.hpp>
 #include <eosio/chain/controller.hpp>
+#include <eosio/data_plugin/time_bucket.hpp>
+#include <eosio/data_plugin/record_key.hpp>
+#include <eosio/data_plugin/aggregator.hpp>
+#include <eosio/data_plugin/flat_trace.hpp>
+#include <eosio/data_plugin/token_action.hpp>
+#include <eosio/data_plugin/projection.hpp>
+#include <eosio/data_plugin/emission_limit.hpp>
 
 namespace eosio{ namespace data{
 
@@ -16,6 +27,17 @@ using namespace chain;
 struct abstract_type {
     typedef vector<pair<string, variant> > key_values;
 
+    enum payload_format {
+        payload_json,   //whole objects as json strings
+        payload_binary  //base64 of the fc::raw packed chain object, newhbase::BlockState only sends a delta when it gets irreversible
+    };
+
+    static payload_format parse_payload_format(const string& f) {
+        if (f == "json")   return payload_json;
+        if (f == "binary") return payload_binary;
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "unknown payload format ${f}, expect json/binary", ("f", f));
+    }
+
     virtual key_values build(const block_state_ptr& bsp, const fc::mutable_variant_object& o) {
         return key_values();
     }
@@ -26,7 +48,61 @@ struct abstract_type {
         return key_values();
     }
 
+    //the table_suffix of the records built from a block time, month unless configured otherwise
+    const string& table_suffix(const block_timestamp_type& t) const {
+        return time_bucket::suffix(t, suffix_granularity);
+    }
+
+    //the key of an action trace carrying index_in_transaction, in the key format of the struct
+    string action_key(const fc::variant_object& trace) const {
+        auto block_num = trace.find("block_num");
+        return keys.action(block_num == trace.end() ? 0 : block_num->value().as<uint32_t>(),
+                           trace["trx_id"].as<transaction_id_type>(), trace["index_in_transaction"].as<uint32_t>());
+    }
+
+    //a whole chain object stored in one column, see payload_format. binary packs the native
+    //object (block_state, transaction_trace), readers unpack it with the chain types; the
+    //configured fields only apply to the json of its variant
+    template <typename T>
+    string payload(const T& native, const fc::mutable_variant_object& obj) const {
+        if (payload_encoding == payload_json)
+            return fc::json::to_string(project(obj), fc::json::legacy_generator);
+        auto packed = fc::raw::pack(*native);
+        return fc::base64_encode(packed.data(), packed.size());
+    }
+
+    //if a top level field of the records has to be built
+    bool wants(const string& field) const {
+        return !projection || projection->wants(field);
+    }
+
+    //structs keeping a whole chain object in one column project inside that object, not the record
+    virtual bool whole_object() const {
+        return false;
+    }
+
+    //the object with the configured fields only
+    fc::variant project(const fc::variant_object& obj) const {
+        if (!projection) return fc::variant(obj);
+        auto projected = projection->apply(fc::variant(obj));
+        if (field_projection::sampling())
+            projection->measure(field_projection::json_size(fc::variant(obj)), field_projection::json_size(projected), name);
+        return projected;
+    }
+
     std::string name;
+    time_bucket::granularity suffix_granularity = time_bucket::month;
+    key_encoding keys;
+    payload_format payload_encoding = payload_json;
+    //only irreversible blocks are produced (data-plugin-fork-mode=irreversible-only) : a struct with a record
+    //for both the accepted and the irreversible event of a block builds a single one from the irreversible event
+    bool irreversible_only = false;
+    //records are rolled up into windows produced as name + ".agg" instead of one by one
+    shared_ptr<window_aggregator> aggregator;
+    //the fields the records keep, all if not set
+    shared_ptr<field_projection> projection;
+    //the sampling and rate limit of the events built, all if not set
+    shared_ptr<emission_limit> limit;
 };
 
 template <typename successor>
@@ -45,6 +121,10 @@ struct type_collection {
         types[type_name].reset(t);
         return t;
     }
+    abstract_type* register_type (const string& type_name, shared_ptr<abstract_type> t) {
+        types[type_name] = t;
+        return t.get();
+    }
     abstract_type* find_type(const std::string& type_name) {
         if (types.find(type_name) == types.end())
             return NULL;
@@ -54,23 +134,24 @@ struct type_collection {
     type_map& get_all_types() {
         return types;
     }
+    //name every struct as prefix.namespace.struct, eosio::data::es::Action is <prefix>.es.action
+    void set_prefix(const string& prefix);
 };
 
 type_collection& types();
 
-inline 
-string build_action_key(const fc::variant_object& trace) {
-    string key = string(trace["trx_id"].as<transaction_id_type>());
-    auto index_in_transaction = trace["index_in_transaction"].as<uint32_t>();
-    const char* index_ptr = (const char*)(&index_in_transaction);
-    for (auto i = 0; i < sizeof(index_in_transaction); i ++) {
-        char tmp[8];
-        sprintf (tmp, "%02x", index_ptr[i]);
-        key += tmp;
-    }
-    return key;
-}
-
+/**
+ * register the structs of a struct file, json as
+ *   {"structs": [{"name": "custom::BigTransfer", "event": "action",
+ *                 "filters": [{"account": "eosio.token", "action": "transfer", "receiver": "@account"}],
+ *                 "fields": {"from": "act.data.from", "amount": "act.data.quantity:amount", "block_time": "@block_time"},
+ *                 "key": "action", "table_suffix": "day", "primary_key": true}]}
+ * event is action/transaction/block, a filter leaves out what matches anything, fields map
+ * an output name to a path or to @block_num/@block_time/@block_id/@trx_id/@table_suffix with
+ * an optional :amount/:symbol/:json/:string, key is action/transaction/block or a template
+ * of fields as "{from}-{block_num}". block structs can set "irreversible": true/false.
+ */
+void load_declared_types(const fc::path& file);
 
 }}
 
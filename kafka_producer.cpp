@@ -1,4 +1,5 @@
 #include <time.h>
+#include <chrono>
 #include <fc/log/logger.hpp>
 #include <cppkafka/cppkafka.h>
 #include <boost/algorithm/string/join.hpp>
@@ -35,6 +36,21 @@ struct KafkaProducer : producer<KafkaProducer> {
         print_payload = options["data-plugin-print-payload"].as<bool>();
         partition_num = options["data-plugin-kafka-partition-num"].as<uint32_t>();
         if (!initialized) return;
+        //the checkpoint only passes a block once kafka acknowledged everything before it
+        kafka_config.set_delivery_report_callback([this](cppkafka::Producer&, const cppkafka::Message& message) {
+            if (message.get_error()) {
+                elog ("kafka producer delivery failed [topic=${topic}] [error=${error}]",
+                    ("topic", message.get_topic())("error", message.get_error().to_string()));
+                if (!checkpoint_stalled) {
+                    //the record stays outstanding for good, said once
+                    checkpoint_stalled = true;
+                    wlog ("kafka producer : a record was not delivered, the checkpoint stays at block ${block} until restart",
+                        ("block", tracker.confirmed()));
+                }
+                return;
+            }
+            tracker.delivered(reinterpret_cast<uint64_t>(message.get_user_data()));
+        });
         kafka_producer = std::make_unique<cppkafka::Producer>(kafka_config);
         auto conf = kafka_producer->get_configuration().get_all();
         ilog ("Kafka config : ${conf}", ("conf", conf));
@@ -47,15 +63,34 @@ struct KafkaProducer : producer<KafkaProducer> {
             try {
                 kafka_producer->flush();
                 ilog ("kafka producer flush finish");
+                flushed = tracker.confirmed();
                 kafka_producer.reset();
+                break;
             } catch (const std::exception& ex) {
                 elog ("std Exception when close kafka producer : ${ex} try again(${i}/5)", ("ex", ex.what())("i", i));
             }
         }
     }
+    void mark(uint32_t block_num) {
+        if (!initialized) return;
+        tracker.mark(block_num);
+        //serve the delivery reports
+        if (kafka_producer)
+            kafka_producer->poll(std::chrono::milliseconds(0));
+    }
+    uint32_t confirmed() {
+        if (!initialized) return 0;
+        return kafka_producer ? tracker.confirmed() : flushed;
+    }
+    uint64_t queue_depth() {
+        if (!initialized || !kafka_producer) return 0;
+        return kafka_producer->get_out_queue_length();
+    }
     void produce (const string& name, const string& key, fc::variant& value) {
         if (!initialized) return;
         auto payload = fc::json::to_string(value, fc::json::legacy_generator);
+        uint64_t seq = 0;
+        bool sent = false;
         try {
             cppkafka::Buffer keyBuffer(key.data(), key.length());
             auto partition = -1;
@@ -67,13 +102,21 @@ struct KafkaProducer : producer<KafkaProducer> {
                     partition = tmp % partition_num;
                 }
             }
-            kafka_producer->produce(cppkafka::MessageBuilder(name).partition(partition).key(keyBuffer).payload(payload));
+            seq = tracker.sent();
+            sent = true;
+            kafka_producer->produce(cppkafka::MessageBuilder(name).partition(partition).key(keyBuffer).payload(payload)
+                                    .user_data(reinterpret_cast<void*>(seq)));
             if (print_payload) {
                 dlog ("${topic} message(size=${size}):\n${payload}", ("size", payload.length())("payload", payload));
             }
         } catch(const std::exception& ex) {
             elog ("std Exception in kafka_producer when produce [ex=${ex}] [topic=${topic}] [key=${key}] [payload=${payload}]",
                 ("ex", ex.what())("topic", name)("key", key)("payload", payload));
+            //librdkafka never got the record, it has no delivery report to wait for
+            if (sent) {
+                tracker.delivered(seq);
+                wlog ("kafka producer : record dropped, the checkpoint goes on past it [topic=${topic}] [key=${key}]", ("topic", name)("key", key));
+            }
         }
     }
     
@@ -82,6 +125,11 @@ struct KafkaProducer : producer<KafkaProducer> {
     bool print_payload;
     bool initialized = false;
     uint32_t partition_num;
+    delivery_tracker tracker;
+    //a failed delivery report was logged
+    std::atomic<bool> checkpoint_stalled{false};
+    //what was confirmed when the producer stopped
+    uint32_t flushed = 0;
 };
 static auto _kafka_producer = eosio::data::producers().register_producer<KafkaProducer>();
 
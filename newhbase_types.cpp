@@ -15,21 +15,22 @@ using namespace chain;
 using key_values = abstract_type::key_values;
 
 struct BlockState : type<BlockState>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const block_state_ptr& bsp, const mutable_variant_object& obj) {
         key_values res;
-        if (!obj["irreversible"]) {
-            string block_time = obj["header"].get_object()["timestamp"].as<string>();
-            size_t replace_pos = block_time.find("-");
-            while (replace_pos != string::npos) {
-                block_time.replace(replace_pos, 1, "");
-                replace_pos = block_time.find("-");
-            }
-            size_t pos = block_time.find('T');
-            if (pos != string::npos) {
-                if (block_time.length() > pos) {
-                    block_time = block_time.substr(0, pos - 2);
-                }
+        if (obj["irreversible"].as<bool>()) {
+            //binary payloads are stored once, the irreversible event only marks the row
+            if (payload_encoding == payload_binary) {
+                auto resobj = fc::mutable_variant_object
+                    ("table_suffix", table_suffix(bsp->header.timestamp))
+                    ("primary_key", bsp->id)
+                    ("info:irreversible", true)
+                ;
+                res.push_back({string(bsp->id), resobj});
             }
+        } else {
             //解析出所有的transactionID
             std::vector<string> trx_ids;
             for (auto trx : bsp->block->transactions) {
@@ -40,10 +41,10 @@ struct BlockState : type<BlockState>{
                 }
             }
             auto resobj = fc::mutable_variant_object
-                ("table_suffix", block_time)
+                ("table_suffix", table_suffix(bsp->header.timestamp))
                 ("primary_key", bsp->id)
 
-                ("origin:json", fc::json::to_string(obj, fc::json::legacy_generator))
+                (payload_encoding == payload_json ? "origin:json" : "origin:raw", payload(bsp, obj))
 
                 ("info:block_id", bsp->id)
                 ("info:block_num",bsp->block_num)
@@ -59,26 +60,15 @@ struct BlockState : type<BlockState>{
 static auto _block_state = eosio::data::types().register_type<BlockState>();
 
 struct TransactionTrace : type<TransactionTrace>{
+    bool whole_object() const {
+        return true;
+    }
     key_values build(const transaction_trace_ptr& ttp, const mutable_variant_object& obj) {
         key_values res;
-        string block_time = obj["block_time"].as<string>();
-        size_t replace_pos = block_time.find("-");
-        while (replace_pos != string::npos) {
-            block_time.replace(replace_pos, 1, "");
-            replace_pos = block_time.find("-");
-        }
-        size_t pos = block_time.find('T');
-        if (pos != string::npos) {
-            if (block_time.length() > pos) {
-                block_time = block_time.substr(0, pos - 2);
-            }
-        }
-        char primary_key[256] = {0};
-        sprintf(primary_key, "%08x %s", ttp->block_num, string(ttp->id).c_str());
         auto resobj = fc::mutable_variant_object
-            ("primary_key", primary_key)
-            ("table_suffix", block_time)
-            ("origin:json", fc::json::to_string(obj, fc::json::legacy_generator))
+            ("primary_key", keys.printable(keys.transaction(ttp->block_num, ttp->id)))
+            ("table_suffix", table_suffix(ttp->block_time))
+            (payload_encoding == payload_json ? "origin:json" : "origin:raw", payload(ttp, obj))
 
             ("info:block_num", ttp->block_num)
             ("info:block_time",ttp->block_time)
@@ -0,0 +1,283 @@
+/**
+ * builds the block structs of a block range straight from a block log, on many threads.
+ *
+ * the range is cut into chunks of blocks. worker threads take the next chunk, read its
+ * blocks (one read at a time, the block log is a single file) and run the struct builders
+ * on them, both as accepted and as irreversible block like nodeos does. with --ordered the
+ * chunks are produced in block order, at most 2 per worker wait to be produced; without it
+ * a chunk is produced as soon as it is built. producers are only called from one thread at
+ * a time, as in nodeos : in order, one worker at a time drains the chunks which are next in
+ * line while the others go on building.
+ *
+ * the block log holds blocks and transaction receipts but no traces, so only the structs
+ * built from blocks have records here. the trace structs cannot be rebuilt without
+ * executing the blocks again : their backfill is data_plugin_replay over the files written
+ * by FileProducer, which already reads the files on parallel reader threads. action data is
+ * decoded with the abi files given by --abi, it stays hex for the other contracts.
+ *
+ * a block is rebuilt from the log with its block, header, id and number only, the rest of its
+ * block_state (producer schedule, confirmations, signing key) is not in the log. the structs
+ * storing the whole block_state, like hbase::IrreversibleBlockState or newhbase::BlockState,
+ * are refused for that.
+ *
+ * options of the producers (data-plugin-*) are accepted as they are. the struct options of
+ * data_plugin are not : table suffix, key format, payload format, fields, limit and
+ * aggregation stay at their defaults, every record is built whole.
+ */
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/data_plugin/types.hpp>
+#include <eosio/data_plugin/producers.hpp>
+
+using namespace eosio::chain;
+using namespace eosio::data;
+using std::vector;
+
+struct backfill_record {
+    string name;
+    string key;
+    fc::variant value;
+};
+
+struct backfill_chunk {
+    uint32_t first;
+    uint32_t last;
+    vector<backfill_record> records;
+    bool built = false;
+};
+
+/**
+ * the abis of the contracts whose action data is decoded
+ */
+struct abi_resolver {
+    void add(const string& spec, const fc::microseconds& max_time) {
+        auto pos = spec.find('=');
+        FC_ASSERT(pos != string::npos, "abi should be account=file : ${s}", ("s", spec));
+        auto abi = fc::json::from_file(spec.substr(pos + 1)).as<abi_def>();
+        abis.emplace(name(spec.substr(0, pos)), abi_serializer(abi, max_time));
+    }
+
+    fc::optional<abi_serializer> operator()(const account_name& account) const {
+        auto it = abis.find(account);
+        if (it == abis.end()) return fc::optional<abi_serializer>();
+        return it->second;
+    }
+
+    std::map<account_name, abi_serializer> abis;
+};
+
+struct backfill {
+    void build(backfill_chunk& chunk) {
+        for (uint32_t num = chunk.first; num <= chunk.last; num ++) {
+            signed_block_ptr block;
+            {
+                std::lock_guard<std::mutex> lock(log_mtx);
+                block = log->read_block_by_num(num);
+            }
+            if (!block) {
+                wlog ("data-backfill : block ${n} is not in the block log", ("n", num));
+                missing ++;
+                continue;
+            }
+            auto bsp = std::make_shared<block_state>();
+            bsp->block = block;
+            bsp->header = *block;
+            bsp->id = block->id();
+            bsp->block_num = block->block_num();
+
+            fc::variant bvariant;
+            abi_serializer::to_variant(bsp, bvariant, std::cref(resolver), max_time);
+            for (bool irreversible : {false, true}) {
+                fc::mutable_variant_object bobject = bvariant.get_object();
+                bobject.set("irreversible", irreversible);
+                for (auto type : targets) {
+                    for (auto& data : type->build(bsp, bobject))
+                        chunk.records.push_back({type->name, std::move(data.first), std::move(data.second)});
+                }
+            }
+            blocks ++;
+        }
+    }
+
+    void produce(backfill_chunk& chunk) {
+        std::lock_guard<std::mutex> lock(produce_mtx);
+        for (auto& r : chunk.records)
+            for (auto producer : sinks)
+                producer->produce(r.name, r.key, r.value);
+        produced += chunk.records.size();
+        chunk.records.clear();
+        chunk.records.shrink_to_fit();
+    }
+
+    std::unique_ptr<block_log> log;
+    std::mutex log_mtx;
+    abi_resolver resolver;
+    fc::microseconds max_time = fc::seconds(10);
+    vector<abstract_type*> targets;
+    vector<abstract_producer*> sinks;
+    std::mutex produce_mtx;
+    std::atomic<uint64_t> blocks{0}, missing{0}, produced{0};
+};
+
+int main(int argc, char** argv) {
+    bpo::options_description backfill_options("data backfill options");
+    backfill_options.add_options()
+        ("help,h", "print this help message and exit")
+        ("blocks-dir", bpo::value<string>(), "the directory holding blocks.log and blocks.index")
+        ("struct", bpo::value<vector<string> >()->composing(), "the structs to build, like eosio::data::es::BlockInfo, can have more than one")
+        ("producer", bpo::value<vector<string> >()->composing(), "the producers to send the records to, can have more than one")
+        ("prefix", bpo::value<string>()->default_value("eosio"), "the prefix of all data struct name")
+        ("start-num", bpo::value<uint32_t>()->default_value(1), "the first block")
+        ("stop-num", bpo::value<uint32_t>()->default_value(UINT32_MAX), "the last block, the head of the block log if past it")
+        ("workers", bpo::value<uint32_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "the threads building records")
+        ("chunk-blocks", bpo::value<uint32_t>()->default_value(1000), "the blocks a worker takes at once")
+        ("ordered", bpo::value<bool>()->default_value(true), "produce the chunks in block order, otherwise as soon as they are built")
+        ("abi", bpo::value<vector<string> >()->composing(), "decode the actions of a contract as account=abi json file, can have more than one")
+    ;
+    options_description all_options;
+    all_options.add(backfill_options);
+    for (auto& p : producers().get_all_producers()) {
+        options_description producer_cli, producer_cfg(p.first + " options");
+        p.second->set_program_options(producer_cli, producer_cfg);
+        all_options.add(producer_cfg);
+    }
+
+    variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, all_options), options);
+    bpo::notify(options);
+    if (options.count("help") || !options.count("blocks-dir") || !options.count("struct") || !options.count("producer")) {
+        std::cout << all_options << std::endl;
+        return options.count("help") ? 0 : 1;
+    }
+
+    backfill job;
+    types().set_prefix(options["prefix"].as<string>());
+    for (auto& name : options["struct"].as<vector<string> >()) {
+        auto type = types().find_type(name);
+        if (!type) {
+            std::cerr << "struct " << name << " is not registered" << std::endl;
+            return 1;
+        }
+        if (type->whole_object()) {
+            std::cerr << "struct " << name << " stores the whole block_state, the block log only rebuilds its block" << std::endl;
+            return 1;
+        }
+        job.targets.push_back(type);
+    }
+    for (auto& name : options["producer"].as<vector<string> >()) {
+        auto producer = producers().find_producer(name);
+        if (!producer) {
+            std::cerr << "producer " << name << " is not registered" << std::endl;
+            return 1;
+        }
+        job.sinks.push_back(producer);
+    }
+    uint32_t first, last;
+    try {
+        if (options.count("abi"))
+            for (auto& abi : options["abi"].as<vector<string> >())
+                job.resolver.add(abi, job.max_time);
+        job.log = std::make_unique<block_log>(options["blocks-dir"].as<string>());
+        FC_ASSERT(job.log->head(), "the block log is empty");
+        first = std::max<uint32_t>(1, options["start-num"].as<uint32_t>());
+        last = std::min(options["stop-num"].as<uint32_t>(), job.log->head()->block_num());
+        FC_ASSERT(first <= last, "nothing to backfill in [${f}, ${l}]", ("f", first)("l", last));
+    } catch (const fc::exception& ex) {
+        std::cerr << ex.to_string() << std::endl;
+        return 1;
+    }
+
+    for (auto producer : job.sinks) {
+        producer->initialize(options);
+        producer->startup();
+    }
+
+    auto chunk_blocks = std::max<uint32_t>(1, options["chunk-blocks"].as<uint32_t>());
+    auto worker_num = std::max<uint32_t>(1, options["workers"].as<uint32_t>());
+    bool ordered = options["ordered"].as<bool>();
+    vector<backfill_chunk> chunks;
+    for (uint64_t num = first; num <= last; num += chunk_blocks)
+        chunks.push_back({uint32_t(num), uint32_t(std::min<uint64_t>(last, num + chunk_blocks - 1))});
+
+    //the next chunk to build and, ordered, the next one to produce and if a worker is producing
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t next_chunk = 0, next_produce = 0;
+    bool producing = false;
+    std::atomic<uint64_t> failed{0};
+    auto begin = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (uint32_t i = 0; i < worker_num; i ++) {
+        workers.emplace_back([&]() {
+            while (true) {
+                size_t c;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    //ordered, the built chunks waiting for their turn stay bounded
+                    cv.wait(lock, [&]() { return !ordered || next_chunk < next_produce + 2 * worker_num; });
+                    if (next_chunk >= chunks.size()) return;
+                    c = next_chunk ++;
+                }
+                auto& chunk = chunks[c];
+                try {
+                    job.build(chunk);
+                } catch (const fc::exception& ex) {
+                    elog ("data-backfill : blocks [${f}, ${l}] failed : ${ex}", ("f", chunk.first)("l", chunk.last)("ex", ex.to_string()));
+                    chunk.records.clear();
+                    failed ++;
+                }
+                if (!ordered) {
+                    job.produce(chunk);
+                    continue;
+                }
+                //whoever builds the chunk which is next in line produces it and those built behind it,
+                //unless a worker is already at it : that one sees the chunk built once it is its turn
+                std::unique_lock<std::mutex> lock(mtx);
+                chunk.built = true;
+                if (!producing) {
+                    producing = true;
+                    while (next_produce < chunks.size() && chunks[next_produce].built) {
+                        auto& ready = chunks[next_produce];
+                        lock.unlock();
+                        job.produce(ready);
+                        lock.lock();
+                        next_produce ++;
+                        ilog ("data-backfill : blocks up to ${l} produced", ("l", ready.last));
+                    }
+                    producing = false;
+                }
+                cv.notify_all();
+            }
+        });
+    }
+    for (auto& t : workers)
+        t.join();
+    auto build_end = std::chrono::steady_clock::now();
+
+    //stop flushes what the producers still hold
+    for (auto producer : job.sinks)
+        producer->stop();
+    auto end = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+    std::cout << "blocks             : " << job.blocks << " of [" << first << ", " << last << "] ("
+              << job.missing << " missing, " << failed << " chunks failed)" << std::endl;
+    std::cout << "records produced   : " << job.produced << " in " << ms(build_end - begin) << " ms" << std::endl;
+    std::cout << "producers stopped  : " << ms(end - build_end) << " ms later" << std::endl;
+    return failed == 0 && job.missing == 0 ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+/**
+ * feeds the files written by FileProducer back through registered producers,
+ * so a rebuilt sink can be backfilled without replaying the chain.
+ *
+ * both the text files (name \t key \t json lines) and the archive segments (.dpa) are read
+ * through a read only memory mapping. archives skip the blocks outside the block range and
+ * without the selected structs, text files are filtered record by record. records which do
+ * not carry a block number are not filtered by the range.
+ *
+ * every input file is read by one of the reader threads. a file keeps its order, files are
+ * interleaved. records are handed to the producers in batches under a lock, as producers
+ * are only called from one thread at a time in nodeos as well.
+ *
+ * options of the producers (data-plugin-*) are accepted as they are.
+ */
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <eosio/data_plugin/producers.hpp>
+#include <eosio/data_plugin/file_output.hpp>
+#include <eosio/data_plugin/file_archive.hpp>
+
+using namespace eosio::data;
+using std::vector;
+namespace bfs = boost::filesystem;
+
+struct replay_filter {
+    bool accept_name(const string& name) const {
+        return names.empty() || names.count(name);
+    }
+    bool accept_block(uint32_t block_num) const {
+        return block_num == 0 || (block_num >= start_num && block_num <= stop_num);
+    }
+
+    std::unordered_set<string> names;
+    uint32_t start_num = 0;
+    uint32_t stop_num = UINT32_MAX;
+};
+
+/**
+ * hands the records of the reader threads to the producers, batch by batch
+ */
+struct replay_sink {
+    struct record {
+        string name;
+        string key;
+        fc::variant value;
+    };
+
+    void produce(vector<record>& batch) {
+        if (batch.empty()) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& r : batch)
+            for (auto producer : targets)
+                producer->produce(r.name, r.key, r.value);
+        produced += batch.size();
+        batch.clear();
+    }
+
+    vector<abstract_producer*> targets;
+    std::mutex mtx;
+    std::atomic<uint64_t> produced{0};
+};
+
+struct replay_reader {
+    replay_reader(const replay_filter& filter, replay_sink& sink, size_t batch_size)
+        : filter(filter), sink(sink), batch_size(batch_size) {}
+
+    void read(const string& file_name) {
+        auto ext = bfs::path(file_name).extension().string();
+        if (ext == ".dpa")
+            read_archive(file_name);
+        else if (ext == ".dpc")
+            wlog ("data-replay : columnar files only keep the druid columns, skip ${f}", ("f", file_name));
+        else
+            read_text(file_name);
+        flush();
+    }
+
+    //hands over what is read and not produced yet, also what was read before a file failed
+    void flush() {
+        sink.produce(batch);
+    }
+
+    uint64_t skipped = 0;
+    uint64_t broken = 0;
+
+private:
+    void add(string&& name, string&& key, fc::variant&& value) {
+        batch.push_back({std::move(name), std::move(key), std::move(value)});
+        if (batch.size() >= batch_size)
+            sink.produce(batch);
+    }
+
+    void read_archive(const string& file_name) {
+        archive_reader reader;
+        reader.open(file_name);
+        auto blocks = reader.blocks_in_range(filter.start_num, filter.stop_num);
+        if (!filter.names.empty()) {
+            //only the blocks holding at least one record of the selected structs
+            std::unordered_set<uint32_t> wanted;
+            for (auto& name : reader.index().names)
+                if (filter.accept_name(name.first))
+                    for (auto& ref : name.second)
+                        wanted.insert(ref.block);
+            blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](uint32_t b){ return !wanted.count(b); }), blocks.end());
+        }
+        for (auto block : blocks) {
+            for (auto& record : reader.read_block(block)) {
+                if (!filter.accept_name(record.name) || !filter.accept_block(record.block_num)) {
+                    skipped ++;
+                    continue;
+                }
+                add(std::move(record.name), std::move(record.key), fc::json::from_string(record.json));
+            }
+        }
+    }
+
+    void read_text(const string& file_name) {
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        FC_ASSERT(fd >= 0, "open ${f} failed", ("f", file_name));
+        struct stat st;
+        ::fstat(fd, &st);
+        size_t size = st.st_size;
+        const char* data = nullptr;
+        if (size > 0) {
+            data = (const char*)::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) data = nullptr;
+        }
+        ::close(fd);
+        if (!data) return;
+        ::madvise((void*)data, size, MADV_SEQUENTIAL);
+
+        const char* end = data + size;
+        for (const char* line = data; line < end; ) {
+            auto eol = (const char*)memchr(line, '\n', end - line);
+            if (!eol) eol = end;
+            auto first = (const char*)memchr(line, '\t', eol - line);
+            auto second = first ? (const char*)memchr(first + 1, '\t', eol - first - 1) : nullptr;
+            if (!second) {
+                broken ++;
+            } else {
+                string name(line, first);
+                if (!filter.accept_name(name)) {
+                    skipped ++;
+                } else {
+                    try {
+                        auto value = fc::json::from_string(string(second + 1, eol));
+                        if (filter.accept_block(record_block_num(value)))
+                            add(std::move(name), text_key::unescape(first + 1, second), std::move(value));
+                        else
+                            skipped ++;
+                    } catch (const fc::exception& ex) {
+                        broken ++;
+                    }
+                }
+            }
+            line = eol + 1;
+        }
+        ::munmap((void*)data, size);
+    }
+
+    const replay_filter& filter;
+    replay_sink& sink;
+    size_t batch_size;
+    vector<replay_sink::record> batch;
+};
+
+static void collect_inputs(const string& input, vector<string>& files) {
+    if (bfs::is_directory(input)) {
+        for (auto& entry : bfs::directory_iterator(input))
+            if (bfs::is_regular_file(entry.path()))
+                files.push_back(entry.path().string());
+    } else {
+        FC_ASSERT(bfs::exists(input), "input ${f} does not exist", ("f", input));
+        files.push_back(input);
+    }
+}
+
+int main(int argc, char** argv) {
+    bpo::options_description replay_options("data replay options");
+    replay_options.add_options()
+        ("help,h", "print this help message and exit")
+        ("input", bpo::value<vector<string> >()->composing(), "the files written by FileProducer, or the directories holding them, can have more than one")
+        ("producer", bpo::value<vector<string> >()->composing(), "the producers to replay into, like eosio::data::KafkaProducer, can have more than one")
+        ("struct", bpo::value<vector<string> >()->composing(), "only replay the records of these destination names, all of them if not set")
+        ("start-num", bpo::value<uint32_t>()->default_value(0), "only replay the records from this block number")
+        ("stop-num", bpo::value<uint32_t>()->default_value(UINT32_MAX), "only replay the records up to this block number")
+        ("readers", bpo::value<uint32_t>()->default_value(4), "the number of files read at the same time")
+        ("batch-size", bpo::value<uint32_t>()->default_value(1024), "the records a reader hands to the producers at once")
+    ;
+    options_description all_options;
+    all_options.add(replay_options);
+    for (auto& p : producers().get_all_producers()) {
+        options_description producer_cli, producer_cfg(p.first + " options");
+        p.second->set_program_options(producer_cli, producer_cfg);
+        all_options.add(producer_cfg);
+    }
+
+    variables_map options;
+    bpo::store(bpo::parse_command_line(argc, argv, all_options), options);
+    bpo::notify(options);
+    if (options.count("help") || !options.count("input") || !options.count("producer")) {
+        std::cout << all_options << std::endl;
+        return options.count("help") ? 0 : 1;
+    }
+
+    replay_filter filter;
+    if (options.count("struct"))
+        for (auto& name : options["struct"].as<vector<string> >())
+            filter.names.insert(name);
+    filter.start_num = options["start-num"].as<uint32_t>();
+    filter.stop_num = options["stop-num"].as<uint32_t>();
+
+    replay_sink sink;
+    for (auto& name : options["producer"].as<vector<string> >()) {
+        auto producer = producers().find_producer(name);
+        if (!producer) {
+            std::cerr << "producer " << name << " is not registered" << std::endl;
+            return 1;
+        }
+        sink.targets.push_back(producer);
+    }
+
+    vector<string> files;
+    try {
+        for (auto& input : options["input"].as<vector<string> >())
+            collect_inputs(input, files);
+    } catch (const fc::exception& ex) {
+        std::cerr << ex.to_string() << std::endl;
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    for (auto producer : sink.targets) {
+        producer->initialize(options);
+        producer->startup();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<size_t> next_file{0};
+    std::atomic<uint64_t> skipped{0}, broken{0}, failed{0};
+    vector<std::thread> readers;
+    auto reader_num = std::max<uint32_t>(1, std::min<size_t>(options["readers"].as<uint32_t>(), files.size()));
+    auto batch_size = std::max<uint32_t>(1, options["batch-size"].as<uint32_t>());
+    for (uint32_t i = 0; i < reader_num; i ++) {
+        readers.emplace_back([&]() {
+            replay_reader reader(filter, sink, batch_size);
+            for (size_t f = next_file ++; f < files.size(); f = next_file ++) {
+                try {
+                    reader.read(files[f]);
+                    ilog ("data-replay : ${f} done", ("f", files[f]));
+                } catch (const fc::exception& ex) {
+                    elog ("data-replay : read ${f} failed : ${ex}", ("f", files[f])("ex", ex.to_string()));
+                    failed ++;
+                } catch (const std::exception& ex) {
+                    elog ("data-replay : read ${f} failed : ${ex}", ("f", files[f])("ex", ex.what()));
+                    failed ++;
+                }
+            }
+            reader.flush();
+            skipped += reader.skipped;
+            broken += reader.broken;
+        });
+    }
+    for (auto& t : readers)
+        t.join();
+    auto read_end = std::chrono::steady_clock::now();
+
+    //stop flushes what the producers still hold
+    for (auto producer : sink.targets)
+        producer->stop();
+    auto end = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+    std::cout << "files              : " << files.size() << " (" << failed << " failed)" << std::endl;
+    std::cout << "records produced   : " << sink.produced << " in " << ms(read_end - begin) << " ms" << std::endl;
+    std::cout << "records filtered   : " << skipped << std::endl;
+    std::cout << "broken lines       : " << broken << std::endl;
+    std::cout << "producers stopped  : " << ms(end - read_end) << " ms later" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
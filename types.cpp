@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <eosio/data_plugin/types.hpp>
 
 namespace eosio{ namespace data{ 
@@ -7,4 +8,25 @@ type_collection& types() {
     return *_types; 
 }
 
+void type_collection::set_prefix(const string& prefix) {
+    for (auto type : types) {
+        string dest_name = type.first;
+        constexpr char replace_from[] = "::";
+        constexpr char replace_to[] = ".";
+        string::size_type pos = dest_name.find(replace_from);
+        while (pos != string::npos) {
+            dest_name = dest_name.replace(pos, sizeof(replace_from) - 1, replace_to);
+            pos = dest_name.find(replace_from);
+        }
+        vector<string> ignore_names = {"eosio.", "data."};
+        for (auto name : ignore_names) {
+            pos = dest_name.find(name);
+            if (pos != string::npos)
+                dest_name.replace(pos, name.length(), "");
+        }
+        std::transform (dest_name.begin(), dest_name.end(), dest_name.begin(), ::tolower);
+        type.second->name = prefix + "." + dest_name;
+    }
+}
+
 }}